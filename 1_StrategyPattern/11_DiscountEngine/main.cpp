@@ -1,9 +1,14 @@
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include "../Money.h"
 
 struct Order 
 {
-    double price;
+    Money price;
     int customerTier;  // 1 = normal,  2 = loyal,  3 = premium
 };
 
@@ -11,28 +16,47 @@ struct Order
 class DiscountStrategy
 {
 public :
-    virtual double applyDiscount(const Order& order) = 0;
+    virtual Money applyDiscount(const Order& order) = 0;
+    virtual ~DiscountStrategy() = default;
+
+    // Prices many orders with one call; the default loops over applyDiscount.
+    virtual void applyDiscountBatch(const Order* orders, std::size_t n, Money* out)
+    {
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            out[i] = applyDiscount(orders[i]);
+        }
+    }
 };
 
 // STEP2 : Concrete Strategies 
 class SeasonalDiscount : public DiscountStrategy
 {
 public :
-    double applyDiscount(const Order& order) override 
+    Money applyDiscount(const Order& order) override 
     {
-        return order.price * 0.90;  // 10% off
+        return order.price.scaled(9000);  // 10% off
+    }
+
+    void applyDiscountBatch(const Order* orders, std::size_t n, Money* out) override
+    {
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            out[i] = orders[i].price;
+        }
+        moneykernels::scale(out, out, n, 9000);
     }
 };
 
 class LoyaltyDiscount : public DiscountStrategy
 {
 public :
-    double applyDiscount(const Order& order) override 
+    Money applyDiscount(const Order& order) override 
     {
-        double discountPrice = order.price;
+        Money discountPrice = order.price;
         if(order.customerTier >= 2)
         {
-            discountPrice = discountPrice * 0.05;
+            discountPrice = discountPrice.scaled(9500);
         }
         return discountPrice; // 5% off
     }
@@ -41,7 +65,7 @@ public :
 class NoDiscount : public DiscountStrategy
 {
 public :
-    double applyDiscount(const Order& order) override 
+    Money applyDiscount(const Order& order) override 
     {
         return order.price; // No Discount
     }
@@ -57,15 +81,36 @@ public :
         strategy = std::move(s);
     }
 
-    double calculateTotal(const Order& order)
+    Money calculateTotal(const Order& order)
     {
         return  strategy ? strategy->applyDiscount(order) : order.price;
     }
+
+    // Sum of every order after discount.
+    Money calculateTotal(const std::vector<Order>& orders)
+    {
+        prices.resize(orders.size());
+        if(strategy)
+        {
+            strategy->applyDiscountBatch(orders.data(), orders.size(), prices.data());
+        }
+        else
+        {
+            for(std::size_t i = 0; i < orders.size(); ++i)
+            {
+                prices[i] = orders[i].price;
+            }
+        }
+        return moneykernels::sum(prices.data(), prices.size());
+    }
+
+private :
+    std::vector<Money> prices;
 };
 
 int main()
 {
-    Order order{100.0, 2};
+    Order order{Money::fromRupees(100.0), 2};
 
     CheckoutService checkout;
     checkout.setStrategy(std::make_unique<SeasonalDiscount>());
@@ -76,5 +121,9 @@ int main()
 
     checkout.setStrategy(std::make_unique<NoDiscount>());
     std::cout << "No Discount: " << checkout.calculateTotal(order) << "\n";
+
+    std::vector<Order> orders = {order, {Money::fromRupees(249.99), 1}, {Money::fromRupees(1200.0), 3}};
+    checkout.setStrategy(std::make_unique<LoyaltyDiscount>());
+    std::cout << "Loyalty, 3 orders: " << checkout.calculateTotal(orders) << "\n";
     return 0;
 }
\ No newline at end of file
@@ -1,6 +1,994 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <variant>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <fstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Thread pool : a fixed set of workers that execute task indices [0, count).
+// run() blocks until every task finished, the calling thread helps out.
+// Only one run() may be active on a pool at a time.
+class ThreadPool
+{
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(std::size_t)>* job = nullptr;
+    std::size_t nextTask = 0;
+    std::size_t taskCount = 0;
+    std::size_t finished = 0;
+    bool stopping = false;
+
+    void workLoop(std::unique_lock<std::mutex>& lock)
+    {
+        while(nextTask < taskCount)
+        {
+            std::size_t task = nextTask++;
+            const std::function<void(std::size_t)>* fn = job;
+            lock.unlock();
+            (*fn)(task);
+            lock.lock();
+            if(++finished == taskCount)
+            {
+                done.notify_all();
+            }
+        }
+    }
+
+public :
+    explicit ThreadPool(unsigned threads)
+    {
+        for(unsigned i = 1; i < threads; ++i)
+        {
+            workers.emplace_back([this]
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                while(true)
+                {
+                    wake.wait(lock, [this]{ return stopping || nextTask < taskCount; });
+                    if(stopping)
+                    {
+                        return;
+                    }
+                    workLoop(lock);
+                }
+            });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread& t : workers)
+        {
+            t.join();
+        }
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    void run(std::size_t tasks, const std::function<void(std::size_t)>& fn)
+    {
+        if(tasks == 0)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        job = &fn;
+        nextTask = 0;
+        taskCount = tasks;
+        finished = 0;
+        wake.notify_all();
+        workLoop(lock);
+        done.wait(lock, [this]{ return finished == taskCount; });
+    }
+};
+
+inline unsigned defaultThreads()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Read-only memory mapping of a whole file. The file handle is closed as soon
+// as the view exists, so many open mappings do not use up descriptors.
+class MappedFile
+{
+    const unsigned char* ptr = nullptr;
+    std::size_t length = 0;
+
+public :
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        length = static_cast<std::size_t>(size.QuadPart);
+        HANDLE mapping = length == 0 ? nullptr : CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping)
+        {
+            ptr = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return length == 0 || ptr != nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        void* p = MAP_FAILED;
+        if(fstat(fd, &st) == 0)
+        {
+            length = static_cast<std::size_t>(st.st_size);
+            p = length == 0 ? nullptr : mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if(p == MAP_FAILED)
+        {
+            length = 0;
+            return false;
+        }
+        if(p)
+        {
+            ptr = static_cast<const unsigned char*>(p);
+            madvise(p, length, MADV_SEQUENTIAL);
+        }
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if(ptr) UnmapViewOfFile(ptr);
+#else
+        if(ptr) munmap(const_cast<unsigned char*>(ptr), length);
+#endif
+        ptr = nullptr;
+        length = 0;
+    }
+
+    // Asks the OS to start reading [offset, offset + len) ahead of use.
+    void prefetch(std::size_t offset, std::size_t len) const
+    {
+#ifndef _WIN32
+        if(offset >= length)
+        {
+            return;
+        }
+        const std::size_t page = 4096;
+        std::size_t begin = offset / page * page;
+        std::size_t end = std::min(length, offset + len);
+        madvise(const_cast<unsigned char*>(ptr) + begin, end - begin, MADV_WILLNEED);
+#else
+        (void)offset;
+        (void)len;
+#endif
+    }
+
+    // Lets the OS drop the whole pages of [offset, offset + len) that were read.
+    void release(std::size_t offset, std::size_t len) const
+    {
+#ifndef _WIN32
+        const std::size_t page = 4096;
+        std::size_t begin = (offset + page - 1) / page * page;
+        std::size_t end = std::min(length, offset + len) / page * page;
+        if(begin < end)
+        {
+            madvise(const_cast<unsigned char*>(ptr) + begin, end - begin, MADV_DONTNEED);
+        }
+#else
+        (void)offset;
+        (void)len;
+#endif
+    }
+
+    const unsigned char* data() const { return ptr; }
+    std::size_t size() const { return length; }
+};
+
+// Sorting kernels used by the concrete strategies
+namespace sortalgo
+{
+    constexpr std::ptrdiff_t insertionThreshold = 24;
+
+    template<typename T, typename Compare = std::less<T>>
+    void insertionSort(T* first, T* last, Compare comp = Compare())
+    {
+        for(T* i = first + 1; i < last; ++i)
+        {
+            T value = std::move(*i);
+            T* j = i;
+            while(j > first && comp(value, *(j - 1)))
+            {
+                *j = std::move(*(j - 1));
+                --j;
+            }
+            *j = std::move(value);
+        }
+    }
+
+    // AVX2 bitonic sorting networks for blocks of up to 64 ints. The input is
+    // padded with INT_MAX to N = 8, 16, 32 or 64 and every compare-exchange
+    // stage works on 8 lanes at once, without data-dependent branches.
+    // Without AVX2 a scalar network is slower than insertion sort, so the
+    // build falls back to it.
+    constexpr std::size_t networkMax = 64;
+
+#if defined(__AVX2__)
+    template<int J>
+    inline __m256i partnerLanes(__m256i v)
+    {
+        if constexpr(J == 1) return _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+        else if constexpr(J == 2) return _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+        else return _mm256_permute2x128_si256(v, v, 0x01);
+    }
+
+    // stage (k, j) with j < 8 : partners live in the same register
+    template<int K, int J, int N>
+    inline void inRegisterStage(__m256i* r)
+    {
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i jBit = _mm256_set1_epi32(J);
+        const __m256i kBit = _mm256_set1_epi32(K);
+        for(int i = 0; i < N / 8; ++i)
+        {
+            __m256i idx = _mm256_add_epi32(lane, _mm256_set1_epi32(i * 8));
+            __m256i upper = _mm256_cmpeq_epi32(_mm256_and_si256(idx, jBit), jBit);
+            __m256i descending = _mm256_cmpeq_epi32(_mm256_and_si256(idx, kBit), kBit);
+            __m256i takeMax = _mm256_xor_si256(upper, descending);
+            __m256i p = partnerLanes<J>(r[i]);
+            r[i] = _mm256_blendv_epi8(_mm256_min_epi32(r[i], p), _mm256_max_epi32(r[i], p), takeMax);
+        }
+    }
+
+    // stage (k, j) with j >= 8 : whole registers are compare-exchanged
+    template<int K, int J, int N>
+    inline void crossRegisterStage(__m256i* r)
+    {
+        constexpr int step = J / 8;
+        for(int i = 0; i < N / 8; ++i)
+        {
+            if(i & step)
+            {
+                continue;
+            }
+            __m256i lo = _mm256_min_epi32(r[i], r[i + step]);
+            __m256i hi = _mm256_max_epi32(r[i], r[i + step]);
+            bool descending = (i * 8) & K;
+            r[i] = descending ? hi : lo;
+            r[i + step] = descending ? lo : hi;
+        }
+    }
+
+    template<int K, int J, int N>
+    inline void bitonicStages(__m256i* r)
+    {
+        if constexpr(J >= 8) crossRegisterStage<K, J, N>(r);
+        else inRegisterStage<K, J, N>(r);
+        if constexpr(J > 1) bitonicStages<K, J / 2, N>(r);
+        else if constexpr(K < N) bitonicStages<K * 2, K, N>(r);
+    }
+
+    template<int N>
+    inline void bitonicNetwork(int* a)
+    {
+        __m256i r[N / 8];
+        for(int i = 0; i < N / 8; ++i)
+        {
+            r[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(a) + i);
+        }
+        bitonicStages<2, 1, N>(r);
+        for(int i = 0; i < N / 8; ++i)
+        {
+            _mm256_store_si256(reinterpret_cast<__m256i*>(a) + i, r[i]);
+        }
+    }
+#endif
+
+    // Sorts n <= networkMax ints with the smallest network that fits.
+    inline void networkSort(int* data, std::size_t n)
+    {
+#if defined(__AVX2__)
+        if(n < 2)
+        {
+            return;
+        }
+        alignas(32) int block[networkMax];
+        std::size_t padded = 8;
+        while(padded < n)
+        {
+            padded <<= 1;
+        }
+        std::copy(data, data + n, block);
+        std::fill(block + n, block + padded, std::numeric_limits<int>::max());
+        switch(padded)
+        {
+            case 8 : bitonicNetwork<8>(block); break;
+            case 16 : bitonicNetwork<16>(block); break;
+            case 32 : bitonicNetwork<32>(block); break;
+            default : bitonicNetwork<64>(block); break;
+        }
+        std::copy(block, block + n, data);
+#else
+        insertionSort(data, data + n);
+#endif
+    }
+
+    // Base case of introsort : insertion sort in general, the network for plain ints.
+    template<typename T, typename Compare>
+    struct SmallSort
+    {
+        static constexpr std::ptrdiff_t threshold = insertionThreshold;
+        static void sort(T* first, T* last, Compare comp) { insertionSort(first, last, comp); }
+    };
+
+#if defined(__AVX2__)
+    template<>
+    struct SmallSort<int, std::less<int>>
+    {
+        static constexpr std::ptrdiff_t threshold = networkMax;
+        static void sort(int* first, int* last, std::less<int>) { networkSort(first, last - first); }
+    };
+#endif
+
+    template<typename T, typename Compare>
+    void siftDown(T* heap, std::ptrdiff_t root, std::ptrdiff_t size, Compare comp)
+    {
+        T value = std::move(heap[root]);
+        while(true)
+        {
+            std::ptrdiff_t child = 2 * root + 1;
+            if(child >= size)
+            {
+                break;
+            }
+            if(child + 1 < size && comp(heap[child], heap[child + 1]))
+            {
+                ++child;
+            }
+            if(!comp(value, heap[child]))
+            {
+                break;
+            }
+            heap[root] = std::move(heap[child]);
+            root = child;
+        }
+        heap[root] = std::move(value);
+    }
+
+    template<typename T, typename Compare>
+    void heapSort(T* first, T* last, Compare comp)
+    {
+        std::ptrdiff_t size = last - first;
+        for(std::ptrdiff_t i = size / 2 - 1; i >= 0; --i)
+        {
+            siftDown(first, i, size, comp);
+        }
+        for(std::ptrdiff_t end = size - 1; end > 0; --end)
+        {
+            std::swap(first[0], first[end]);
+            siftDown(first, 0, end, comp);
+        }
+    }
+
+    // Moves the median of first/middle/last-1 to *first and returns the Hoare split point.
+    template<typename T, typename Compare>
+    T* partition(T* first, T* last, Compare comp)
+    {
+        T* mid = first + (last - first) / 2;
+        T* back = last - 1;
+        if(comp(*mid, *first)) std::swap(*mid, *first);
+        if(comp(*back, *mid)) std::swap(*back, *mid);
+        if(comp(*mid, *first)) std::swap(*mid, *first);
+        std::swap(*first, *mid);
+
+        T* lo = first;
+        T* hi = last;
+        while(true)
+        {
+            do { ++lo; } while(comp(*lo, *first));
+            do { --hi; } while(comp(*first, *hi));
+            if(lo >= hi)
+            {
+                break;
+            }
+            std::swap(*lo, *hi);
+        }
+        std::swap(*first, *hi);
+        return hi;
+    }
+
+    template<typename T, typename Compare>
+    void introSortLoop(T* first, T* last, int depthLimit, Compare comp)
+    {
+        while(last - first > SmallSort<T, Compare>::threshold)
+        {
+            if(depthLimit == 0)
+            {
+                heapSort(first, last, comp);
+                return;
+            }
+            --depthLimit;
+            T* cut = partition(first, last, comp);
+            // recurse into the smaller half, loop on the larger one
+            if(cut - first < last - cut)
+            {
+                introSortLoop(first, cut, depthLimit, comp);
+                first = cut + 1;
+            }
+            else
+            {
+                introSortLoop(cut + 1, last, depthLimit, comp);
+                last = cut;
+            }
+        }
+        SmallSort<T, Compare>::sort(first, last, comp);
+    }
+
+    template<typename T, typename Compare = std::less<T>>
+    void introSort(T* first, T* last, Compare comp = Compare())
+    {
+        std::ptrdiff_t n = last - first;
+        int depthLimit = 0;
+        while(n > 1)
+        {
+            n >>= 1;
+            depthLimit += 2;
+        }
+        introSortLoop(first, last, depthLimit, comp);
+    }
+
+    // Sorts many independent arrays stored back to back : array i is
+    // [offsets[i], offsets[i + 1]). Arrays longer than networkMax use introsort.
+    inline void sortSmallArrays(int* values, const std::size_t* offsets, std::size_t count)
+    {
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            int* first = values + offsets[i];
+            std::size_t n = offsets[i + 1] - offsets[i];
+            if(n <= networkMax)
+            {
+                networkSort(first, n);
+            }
+            else
+            {
+                introSort(first, first + n);
+            }
+        }
+    }
+
+    // Hoare partition around *first without the median-of-3 sentinel, used by
+    // the median-of-medians fallback where no element is known to stop the scan.
+    template<typename T, typename Compare>
+    T* partitionAroundFirst(T* first, T* last, Compare comp)
+    {
+        T* lo = first;
+        T* hi = last;
+        while(true)
+        {
+            do { ++lo; } while(lo < last && comp(*lo, *first));
+            do { --hi; } while(comp(*first, *hi));
+            if(lo >= hi)
+            {
+                break;
+            }
+            std::swap(*lo, *hi);
+        }
+        std::swap(*first, *hi);
+        return hi;
+    }
+
+    template<typename T, typename Compare>
+    void select(T* first, T* nth, T* last, Compare comp);
+
+    // Median of the medians of groups of 5 : a pivot with at least 30% of the range on each side.
+    template<typename T, typename Compare>
+    T* medianOfMedians(T* first, T* last, Compare comp)
+    {
+        std::size_t n = last - first;
+        std::size_t groups = 0;
+        for(std::size_t g = 0; g < n; g += 5, ++groups)
+        {
+            T* groupEnd = first + std::min(n, g + 5);
+            insertionSort(first + g, groupEnd, comp);
+            std::swap(first[groups], first[g + (groupEnd - (first + g) - 1) / 2]);
+        }
+        T* median = first + (groups - 1) / 2;
+        select(first, median, first + groups, comp);
+        return median;
+    }
+
+    // Quickselect with median-of-3 pivots; after 2*log2(n) rounds without
+    // finishing it switches to median-of-medians pivots, which keeps it O(n).
+    template<typename T, typename Compare>
+    void select(T* first, T* nth, T* last, Compare comp)
+    {
+        int budget = 0;
+        for(std::ptrdiff_t n = last - first; n > 1; n >>= 1)
+        {
+            budget += 2;
+        }
+        while(last - first > insertionThreshold)
+        {
+            T* cut;
+            if(budget > 0)
+            {
+                --budget;
+                cut = partition(first, last, comp);
+            }
+            else
+            {
+                std::swap(*first, *medianOfMedians(first, last, comp));
+                cut = partitionAroundFirst(first, last, comp);
+            }
+            if(cut == nth)
+            {
+                return;
+            }
+            if(nth < cut)
+            {
+                last = cut;
+            }
+            else
+            {
+                first = cut + 1;
+            }
+        }
+        insertionSort(first, last, comp);
+    }
+
+    // Number of elements taken from a when the first k merged outputs are formed (ties go to a).
+    template<typename T, typename Compare>
+    std::size_t coRank(std::size_t k, const T* a, std::size_t na, const T* b, std::size_t nb, Compare comp)
+    {
+        std::size_t lo = k > nb ? k - nb : 0;
+        std::size_t hi = std::min(k, na);
+        while(lo < hi)
+        {
+            std::size_t i = lo + (hi - lo) / 2;
+            std::size_t j = k - i;
+            if(j > 0 && i < na && !comp(b[j - 1], a[i]))
+            {
+                lo = i + 1;
+            }
+            else
+            {
+                hi = i;
+            }
+        }
+        return lo;
+    }
+
+    template<typename T, typename Compare>
+    void mergeRange(const T* a, const T* aEnd, const T* b, const T* bEnd, T* out, T* outEnd, Compare comp)
+    {
+        while(out < outEnd && a < aEnd && b < bEnd)
+        {
+            *out++ = comp(*b, *a) ? *b++ : *a++;
+        }
+        while(out < outEnd && a < aEnd)
+        {
+            *out++ = *a++;
+        }
+        while(out < outEnd && b < bEnd)
+        {
+            *out++ = *b++;
+        }
+    }
+
+    // Leaves are sorted in parallel, then every merge round is split into equal
+    // output slices (merge path) so all workers stay busy up to the last round.
+    template<typename T, typename Compare = std::less<T>>
+    void parallelMergeSort(ThreadPool& pool, T* base, std::size_t n, std::vector<T>& buffer, Compare comp = Compare())
+    {
+        constexpr std::size_t parallelCutoff = 1 << 15;
+        constexpr std::size_t minSlice = 1 << 14;
+        if(n < parallelCutoff || pool.size() == 1)
+        {
+            introSort(base, base + n, comp);
+            return;
+        }
+
+        std::size_t leaves = 1;
+        while(leaves < pool.size())
+        {
+            leaves <<= 1;
+        }
+        std::vector<std::size_t> bounds(leaves + 1);
+        for(std::size_t i = 0; i <= leaves; ++i)
+        {
+            bounds[i] = n * i / leaves;
+        }
+        pool.run(leaves, [&](std::size_t leaf)
+        {
+            introSort(base + bounds[leaf], base + bounds[leaf + 1], comp);
+        });
+
+        struct MergeTask
+        {
+            std::size_t aBegin, mid, bEnd;  // runs [aBegin, mid) and [mid, bEnd)
+            std::size_t outBegin, outEnd;   // offsets inside the merged pair
+        };
+
+        buffer.resize(n);
+        T* src = base;
+        T* dst = buffer.data();
+        const std::size_t slice = std::max(minSlice, n / (pool.size() * 4));
+        std::vector<MergeTask> tasks;
+        while(bounds.size() > 2)
+        {
+            tasks.clear();
+            std::vector<std::size_t> next;
+            for(std::size_t p = 0; p + 2 < bounds.size(); p += 2)
+            {
+                std::size_t len = bounds[p + 2] - bounds[p];
+                for(std::size_t off = 0; off < len; off += slice)
+                {
+                    tasks.push_back({bounds[p], bounds[p + 1], bounds[p + 2], off, std::min(len, off + slice)});
+                }
+                next.push_back(bounds[p]);
+            }
+            next.push_back(n);
+
+            pool.run(tasks.size(), [&](std::size_t t)
+            {
+                const MergeTask& task = tasks[t];
+                const T* a = src + task.aBegin;
+                const T* b = src + task.mid;
+                std::size_t na = task.mid - task.aBegin;
+                std::size_t nb = task.bEnd - task.mid;
+                std::size_t i = coRank(task.outBegin, a, na, b, nb, comp);
+                std::size_t j = task.outBegin - i;
+                T* out = dst + task.aBegin;
+                mergeRange(a + i, a + na, b + j, b + nb, out + task.outBegin, out + task.outEnd, comp);
+            });
+
+            bounds.swap(next);
+            std::swap(src, dst);
+        }
+
+        if(src != base)
+        {
+            const std::size_t chunks = pool.size();
+            pool.run(chunks, [&](std::size_t c)
+            {
+                std::size_t from = n * c / chunks;
+                std::size_t to = n * (c + 1) / chunks;
+                std::copy(src + from, src + to, base + from);
+            });
+        }
+    }
+
+    // Parallel selection : two pivots taken from a sorted sample bracket rank k,
+    // every worker classifies its chunk (below / between / above) and scatters
+    // it into place, and only the small middle class is searched afterwards.
+    template<typename T, typename Compare = std::less<T>>
+    void parallelSelect(ThreadPool& pool, T* base, std::size_t n, std::size_t k, std::vector<T>& buffer, Compare comp = Compare())
+    {
+        constexpr std::size_t parallelCutoff = 1 << 16;
+        constexpr std::size_t sampleSize = 4096;
+        while(n >= parallelCutoff && pool.size() > 1)
+        {
+            std::vector<T> sample(sampleSize);
+            for(std::size_t s = 0; s < sampleSize; ++s)
+            {
+                // multiplicative hash spreads the picks without touching the data twice
+                std::size_t i = static_cast<std::size_t>((s * 0x9E3779B97F4A7C15ull) % n);
+                sample[s] = base[i];
+            }
+            introSort(sample.data(), sample.data() + sampleSize, comp);
+            std::size_t rank = static_cast<std::size_t>((double)k / n * sampleSize);
+            std::size_t spread = 64;
+            T low = sample[rank > spread ? rank - spread : 0];
+            T high = sample[std::min(sampleSize - 1, rank + spread)];
+
+            const std::size_t chunks = pool.size() * 4;
+            std::vector<std::size_t> counts(chunks * 3, 0);
+            pool.run(chunks, [&](std::size_t c)
+            {
+                std::size_t* cnt = &counts[c * 3];
+                for(std::size_t i = n * c / chunks, end = n * (c + 1) / chunks; i < end; ++i)
+                {
+                    cnt[comp(base[i], low) ? 0 : comp(high, base[i]) ? 2 : 1]++;
+                }
+            });
+            std::size_t totals[3] = {0, 0, 0};
+            for(std::size_t c = 0; c < chunks; ++c)
+            {
+                for(int cls = 0; cls < 3; ++cls)
+                {
+                    totals[cls] += counts[c * 3 + cls];
+                }
+            }
+            // turn counts into write offsets : class by class, chunk by chunk
+            std::size_t offset = 0;
+            for(int cls = 0; cls < 3; ++cls)
+            {
+                for(std::size_t c = 0; c < chunks; ++c)
+                {
+                    std::size_t count = counts[c * 3 + cls];
+                    counts[c * 3 + cls] = offset;
+                    offset += count;
+                }
+            }
+            buffer.resize(n);
+            T* out = buffer.data();
+            pool.run(chunks, [&](std::size_t c)
+            {
+                std::size_t pos[3] = {counts[c * 3], counts[c * 3 + 1], counts[c * 3 + 2]};
+                for(std::size_t i = n * c / chunks, end = n * (c + 1) / chunks; i < end; ++i)
+                {
+                    int cls = comp(base[i], low) ? 0 : comp(high, base[i]) ? 2 : 1;
+                    out[pos[cls]++] = base[i];
+                }
+            });
+            pool.run(chunks, [&](std::size_t c)
+            {
+                std::copy(out + n * c / chunks, out + n * (c + 1) / chunks, base + n * c / chunks);
+            });
+
+            if(k < totals[0])
+            {
+                n = totals[0];
+            }
+            else if(k < totals[0] + totals[1])
+            {
+                base += totals[0];
+                k -= totals[0];
+                n = totals[1];
+                break;
+            }
+            else
+            {
+                base += totals[0] + totals[1];
+                k -= totals[0] + totals[1];
+                n = totals[2];
+            }
+        }
+        select(base, base + k, base + n, comp);
+    }
+
+    // Splits data into natural runs (TimSort style): non-decreasing runs are kept,
+    // strictly decreasing runs are reversed and runs shorter than minRun are
+    // extended with insertion sort. bounds receives run starts plus n.
+    constexpr std::size_t minRun = 32;
+
+    template<typename T, typename Compare = std::less<T>>
+    void findRuns(T* data, std::size_t n, std::vector<std::size_t>& bounds, Compare comp = Compare())
+    {
+        bounds.clear();
+        std::size_t start = 0;
+        while(start < n)
+        {
+            std::size_t end = start + 1;
+            if(end < n && comp(data[end], data[start]))
+            {
+                while(end < n && comp(data[end], data[end - 1]))
+                {
+                    ++end;
+                }
+                std::reverse(data + start, data + end);
+            }
+            else
+            {
+                while(end < n && !comp(data[end], data[end - 1]))
+                {
+                    ++end;
+                }
+            }
+            if(end - start < minRun && end < n)
+            {
+                end = std::min(n, start + minRun);
+                insertionSort(data + start, data + end, comp);
+            }
+            bounds.push_back(start);
+            start = end;
+        }
+        bounds.push_back(n);
+    }
+
+    // Merges adjacent runs pairwise until one is left; O(n log runs).
+    template<typename T, typename Compare = std::less<T>>
+    void mergeRuns(T* data, std::size_t n, std::vector<std::size_t>& bounds, T* buffer, Compare comp = Compare())
+    {
+        T* src = data;
+        T* dst = buffer;
+        std::vector<std::size_t> next;
+        while(bounds.size() > 2)
+        {
+            next.clear();
+            std::size_t p = 0;
+            for(; p + 2 < bounds.size(); p += 2)
+            {
+                mergeRange(src + bounds[p], src + bounds[p + 1], src + bounds[p + 1], src + bounds[p + 2],
+                           dst + bounds[p], dst + bounds[p + 2], comp);
+                next.push_back(bounds[p]);
+            }
+            if(p + 2 == bounds.size())
+            {
+                std::copy(src + bounds[p], src + n, dst + bounds[p]);
+                next.push_back(bounds[p]);
+            }
+            next.push_back(n);
+            bounds.swap(next);
+            std::swap(src, dst);
+        }
+        if(src != data)
+        {
+            std::copy(src, src + n, data);
+        }
+    }
+
+    template<typename T, typename Compare = std::less<T>>
+    void naturalMergeSort(T* data, std::size_t n, T* buffer, Compare comp = Compare())
+    {
+        std::vector<std::size_t> bounds;
+        findRuns(data, n, bounds, comp);
+        mergeRuns(data, n, bounds, buffer, comp);
+    }
+
+    // data[0, sorted) is already in order and data[sorted, n) is a new batch.
+    // The batch is sorted on its own (runs are detected, so a presorted batch
+    // costs O(batch)), then merged from the back : only the prefix elements
+    // greater than the batch minimum move. buffer needs room for the batch only.
+    template<typename T, typename Compare = std::less<T>>
+    void mergeAppended(T* data, std::size_t sorted, std::size_t n, std::vector<T>& buffer, Compare comp = Compare())
+    {
+        std::size_t batch = n - sorted;
+        if(batch == 0)
+        {
+            return;
+        }
+        buffer.resize(batch);
+        naturalMergeSort(data + sorted, batch, buffer.data(), comp);
+        if(sorted == 0 || !comp(data[sorted], data[sorted - 1]))
+        {
+            return;
+        }
+
+        T* split = std::upper_bound(data, data + sorted, data[sorted], comp);
+        std::copy(data + sorted, data + n, buffer.data());
+        T* a = data + sorted;          // one past the prefix part still to merge
+        T* b = buffer.data() + batch;  // one past the batch part still to merge
+        T* out = data + n;
+        while(b != buffer.data())
+        {
+            if(a != split && comp(*(b - 1), *(a - 1)))
+            {
+                *--out = std::move(*--a);
+            }
+            else
+            {
+                *--out = std::move(*--b);
+            }
+        }
+    }
+
+    // LSD radix sort, 4 passes of 8 bits over the sign-flipped key.
+    // All four histograms are built in one read pass and passes where every key
+    // shares the digit are skipped. The scatter goes through per-bucket
+    // cache-line buffers so each bucket is written 64 bytes at a time.
+    constexpr int radixBits = 8;
+    constexpr std::size_t radixBuckets = 1 << radixBits;
+    constexpr std::size_t lineInts = 64 / sizeof(int);
+
+    inline unsigned radixKey(int value)
+    {
+        return static_cast<unsigned>(value) ^ 0x80000000u;
+    }
+
+    inline void radixSort(int* data, std::size_t n, int* buffer)
+    {
+        if(n < 2)
+        {
+            return;
+        }
+        std::vector<std::size_t> hist(4 * radixBuckets, 0);
+        std::size_t* h0 = hist.data();
+        std::size_t* h1 = h0 + radixBuckets;
+        std::size_t* h2 = h1 + radixBuckets;
+        std::size_t* h3 = h2 + radixBuckets;
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            unsigned key = radixKey(data[i]);
+            ++h0[key & 0xFF];
+            ++h1[(key >> 8) & 0xFF];
+            ++h2[(key >> 16) & 0xFF];
+            ++h3[key >> 24];
+        }
+
+        alignas(64) int lines[radixBuckets][lineInts];
+        unsigned char fill[radixBuckets];
+        std::size_t offset[radixBuckets];
+
+        int* src = data;
+        int* dst = buffer;
+        for(int pass = 0; pass < 4; ++pass)
+        {
+            const std::size_t* h = h0 + pass * radixBuckets;
+            const int shift = pass * radixBits;
+            if(h[(radixKey(src[0]) >> shift) & 0xFF] == n)
+            {
+                continue;
+            }
+            std::size_t sum = 0;
+            for(std::size_t d = 0; d < radixBuckets; ++d)
+            {
+                offset[d] = sum;
+                sum += h[d];
+                fill[d] = 0;
+            }
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                int value = src[i];
+                unsigned d = (radixKey(value) >> shift) & 0xFF;
+                lines[d][fill[d]++] = value;
+                if(fill[d] == lineInts)
+                {
+                    std::copy(lines[d], lines[d] + lineInts, dst + offset[d]);
+                    offset[d] += lineInts;
+                    fill[d] = 0;
+                }
+            }
+            for(std::size_t d = 0; d < radixBuckets; ++d)
+            {
+                std::copy(lines[d], lines[d] + fill[d], dst + offset[d]);
+            }
+            std::swap(src, dst);
+        }
+        if(src != data)
+        {
+            std::copy(src, src + n, data);
+        }
+    }
+}
 
 // step1 : Strategy Interface
 class SortStrategy
@@ -8,34 +996,553 @@ class SortStrategy
 public :
     virtual void sort(std::vector<int>& data) = 0;
     virtual ~SortStrategy() = default;
+
+    // Puts the element of rank k at data[k], smaller or equal ones before it and
+    // greater or equal ones after it. The default simply sorts everything.
+    virtual void nthElement(std::vector<int>& data, std::size_t k)
+    {
+        (void)k;
+        sort(data);
+    }
+
+    // Sorts the k smallest elements into data[0, k), the rest is left unordered.
+    virtual void partialSort(std::vector<int>& data, std::size_t k)
+    {
+        (void)k;
+        sort(data);
+    }
+
+    // Sorts a file of native-endian binary ints. The default loads it into memory.
+    virtual bool sortFile(const std::string& input, const std::string& output)
+    {
+        std::vector<int> data;
+        if(!readIntFile(input, data))
+        {
+            std::cout<<"could not read "<<input<<std::endl;
+            return false;
+        }
+        sort(data);
+        if(!writeIntFile(output, data.data(), data.size()))
+        {
+            std::cout<<"could not write "<<output<<std::endl;
+            return false;
+        }
+        return true;
+    }
+
+protected :
+    static bool readIntFile(const std::string& path, std::vector<int>& data)
+    {
+        FILE* f = std::fopen(path.c_str(), "rb");
+        if(!f)
+        {
+            return false;
+        }
+        const std::size_t chunk = 1 << 20;
+        data.clear();
+        std::size_t bytes = 0;
+        do
+        {
+            data.resize(data.size() + chunk);
+            bytes = std::fread(data.data() + data.size() - chunk, 1, chunk * sizeof(int), f);
+            data.resize(data.size() - chunk + bytes / sizeof(int));
+        } while(bytes == chunk * sizeof(int));
+        // a trailing partial int means the file is not an int file
+        bool ok = !std::ferror(f) && bytes % sizeof(int) == 0;
+        std::fclose(f);
+        return ok;
+    }
+
+    static bool writeIntFile(const std::string& path, const int* data, std::size_t count)
+    {
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if(!f)
+        {
+            return false;
+        }
+        bool ok = std::fwrite(data, sizeof(int), count, f) == count;
+        return std::fclose(f) == 0 && ok;
+    }
+};
+
+// step2 : Concrete Strategies
+// QuickSort : introsort (median-of-3 quicksort, heapsort fallback, insertion sort for small ranges)
+class QuickSort : public SortStrategy
+{
+public :
+    void sort(std::vector<int>& data) override
+    {
+        std::cout<<"sorting using quick sort"<<std::endl;
+        sortalgo::introSort(data.data(), data.data() + data.size());
+    }
+
+    void nthElement(std::vector<int>& data, std::size_t k) override
+    {
+        if(k >= data.size())
+        {
+            return;
+        }
+        std::cout<<"selecting using quick select"<<std::endl;
+        int* first = data.data();
+        sortalgo::select(first, first + k, first + data.size(), std::less<int>());
+    }
+
+    void partialSort(std::vector<int>& data, std::size_t k) override
+    {
+        k = std::min(k, data.size());
+        if(k == 0)
+        {
+            return;
+        }
+        std::cout<<"partial sort using quick select"<<std::endl;
+        int* first = data.data();
+        sortalgo::select(first, first + k - 1, first + data.size(), std::less<int>());
+        sortalgo::introSort(first, first + k);
+    }
+};
+
+// MergeSort : parallel merge sort on its own thread pool
+class MergeSort : public SortStrategy
+{
+    ThreadPool pool;
+    std::vector<int> buffer;
+
+public :
+    explicit MergeSort(unsigned threads = defaultThreads()) : pool(threads) {}
+
+    void sort(std::vector<int>& data) override
+    {
+        std::cout<<"sorting using merge sort"<<std::endl;
+        sortalgo::parallelMergeSort(pool, data.data(), data.size(), buffer);
+    }
+
+    void nthElement(std::vector<int>& data, std::size_t k) override
+    {
+        if(k >= data.size())
+        {
+            return;
+        }
+        std::cout<<"selecting using parallel select"<<std::endl;
+        sortalgo::parallelSelect(pool, data.data(), data.size(), k, buffer);
+    }
+
+    void partialSort(std::vector<int>& data, std::size_t k) override
+    {
+        k = std::min(k, data.size());
+        if(k == 0)
+        {
+            return;
+        }
+        std::cout<<"partial sort using parallel select + merge sort"<<std::endl;
+        sortalgo::parallelSelect(pool, data.data(), data.size(), k - 1, buffer);
+        sortalgo::parallelMergeSort(pool, data.data(), k, buffer);
+    }
+};
+
+// RadixSort : LSD radix sort for 32-bit keys, O(n) with one extra buffer
+class RadixSort : public SortStrategy
+{
+    std::vector<int> buffer;
+public :
+    void sort(std::vector<int>& data) override
+    {
+        std::cout<<"sorting using radix sort"<<std::endl;
+        buffer.resize(data.size());
+        sortalgo::radixSort(data.data(), data.size(), buffer.data());
+    }
+};
+
+// Cheap summary of the input, computed from a fixed-size sample.
+struct DataProfile
+{
+    std::size_t size = 0;
+    double ascendingRatio = 0.0;   // sampled neighbour pairs with a[i] <= a[i+1]
+    double descendingRatio = 0.0;  // sampled neighbour pairs with a[i] >= a[i+1]
+    double duplicateRatio = 0.0;   // 1 - distinct / sampled values
+    std::size_t distinctSampled = 0;
+    long long keyRange = 0;        // max - min of the sampled values
+
+    // Bytes a radix sort has to pass over to order keys spanning keyRange.
+    int radixPasses() const
+    {
+        int passes = 1;
+        while(passes < 4 && (static_cast<unsigned long long>(keyRange) >> (8 * passes)) != 0)
+        {
+            ++passes;
+        }
+        return passes;
+    }
+
+    // Levels of a comparison sort : log2 of the distinct keys, estimated from
+    // the sample when it is mostly duplicates and bounded by the size otherwise.
+    double comparisonLevels() const
+    {
+        return std::log2(double(std::max<std::size_t>(1, duplicateRatio > 0.5 ? distinctSampled : size)));
+    }
+
+    static DataProfile of(const std::vector<int>& data, std::size_t samples = 1024)
+    {
+        DataProfile p;
+        p.size = data.size();
+        if(data.size() < 2)
+        {
+            p.ascendingRatio = p.descendingRatio = 1.0;
+            return p;
+        }
+        std::size_t pairs = std::min(samples, data.size() - 1);
+        std::vector<int> values;
+        values.reserve(pairs);
+        std::size_t ascending = 0;
+        std::size_t descending = 0;
+        for(std::size_t s = 0; s < pairs; ++s)
+        {
+            std::size_t i = (data.size() - 1) * s / pairs;
+            ascending += data[i] <= data[i + 1];
+            descending += data[i] >= data[i + 1];
+            values.push_back(data[i]);
+        }
+        sortalgo::introSort(values.data(), values.data() + values.size());
+        std::size_t distinct = std::unique(values.begin(), values.end()) - values.begin();
+        p.ascendingRatio = double(ascending) / pairs;
+        p.descendingRatio = double(descending) / pairs;
+        p.duplicateRatio = 1.0 - double(distinct) / values.size();
+        p.distinctSampled = distinct;
+        p.keyRange = (long long)values.back() - values.front();
+        return p;
+    }
+};
+
+// AutoSort : samples the input and dispatches to the kernel that fits its shape
+class AutoSort : public SortStrategy
+{
+    MergeSort parallelSort;
+    QuickSort quickSelect;
+    std::vector<int> buffer;
+    unsigned threads;
+
+public :
+    static constexpr std::size_t tinySize = 64;
+    static constexpr std::size_t radixSizePerPass = 256;
+    static constexpr std::size_t parallelMinSize = 1 << 22;
+    static constexpr double nearlySortedRatio = 0.97;
+
+    explicit AutoSort(unsigned threads_ = defaultThreads()) : parallelSort(threads_), threads(threads_) {}
+
+    void sort(std::vector<int>& data) override
+    {
+        DataProfile p = DataProfile::of(data);
+        int* first = data.data();
+        int* last = first + data.size();
+
+        if(p.size <= tinySize)
+        {
+            std::cout<<"auto sort : insertion sort for "<<p.size<<" elements"<<std::endl;
+            sortalgo::insertionSort(first, last);
+        }
+        else if(p.ascendingRatio >= nearlySortedRatio || p.descendingRatio >= nearlySortedRatio)
+        {
+            std::cout<<"auto sort : merging natural runs"<<std::endl;
+            buffer.resize(p.size);
+            sortalgo::naturalMergeSort(first, p.size, buffer.data());
+        }
+        else if(p.size >= parallelMinSize && threads > 1)
+        {
+            std::cout<<"auto sort : parallel merge sort on "<<threads<<" threads"<<std::endl;
+            parallelSort.sort(data);
+        }
+        // radix costs one pass per key byte plus a fixed setup per pass, a comparison
+        // sort one level per doubling of the distinct keys : few wide keys favour
+        // quick sort, many keys or a narrow range favour radix once it is amortised
+        else if(p.size >= radixSizePerPass * p.radixPasses() && p.radixPasses() <= 2 * p.comparisonLevels())
+        {
+            std::cout<<"auto sort : radix sort over "<<p.radixPasses()<<" key bytes"<<std::endl;
+            buffer.resize(p.size);
+            sortalgo::radixSort(first, p.size, buffer.data());
+        }
+        else
+        {
+            std::cout<<"auto sort : quick sort"<<std::endl;
+            sortalgo::introSort(first, last);
+        }
+    }
+
+    void nthElement(std::vector<int>& data, std::size_t k) override
+    {
+        if(data.size() >= parallelMinSize && threads > 1)
+        {
+            parallelSort.nthElement(data, k);
+        }
+        else
+        {
+            quickSelect.nthElement(data, k);
+        }
+    }
+
+    void partialSort(std::vector<int>& data, std::size_t k) override
+    {
+        if(data.size() >= parallelMinSize && threads > 1)
+        {
+            parallelSort.partialSort(data, k);
+        }
+        else
+        {
+            quickSelect.partialSort(data, k);
+        }
+    }
 };
 
-// step2 : Concrete Strategies
-class QuickSort : public SortStrategy 
+// Loser tree over k sorted sources : the winner is the smallest current key,
+// replacing it replays one leaf-to-root path of log2(k) comparisons.
+class LoserTree
 {
-public :
-    void sort(std::vector<int>& data) override 
+    std::vector<int> keys;
+    std::vector<char> exhausted;
+    std::vector<std::size_t> tree;  // tree[0] is the winner, tree[1..k-1] hold losers
+    std::size_t k;
+
+    bool less(std::size_t a, std::size_t b) const
     {
-        std::cout<<"sorting using quick sort"<<std::endl;
-        // imagine QuickSort implementation here
+        if(exhausted[a]) return false;
+        if(exhausted[b]) return true;
+        return keys[a] < keys[b];
+    }
+
+    std::size_t build(std::size_t node)
+    {
+        if(node >= k)
+        {
+            return node - k;
+        }
+        std::size_t left = build(2 * node);
+        std::size_t right = build(2 * node + 1);
+        if(less(right, left))
+        {
+            tree[node] = left;
+            return right;
+        }
+        tree[node] = right;
+        return left;
+    }
+
+    void replay(std::size_t source)
+    {
+        std::size_t w = source;
+        for(std::size_t node = (source + k) / 2; node >= 1; node /= 2)
+        {
+            if(less(tree[node], w))
+            {
+                std::swap(tree[node], w);
+            }
+        }
+        tree[0] = w;
     }
+
+public :
+    explicit LoserTree(std::size_t sources)
+        : keys(sources), exhausted(sources, 1), tree(std::max<std::size_t>(sources, 1), 0), k(sources) {}
+
+    void set(std::size_t source, int key) { keys[source] = key; exhausted[source] = 0; }
+    void init() { tree[0] = k ? build(1) : 0; }
+
+    bool empty() const { return k == 0 || exhausted[tree[0]]; }
+    std::size_t winner() const { return tree[0]; }
+    int top() const { return keys[tree[0]]; }
+
+    void pushWinner(int key) { keys[tree[0]] = key; replay(tree[0]); }
+    void dropWinner() { exhausted[tree[0]] = 1; replay(tree[0]); }
 };
 
-class MergeSort : public SortStrategy 
+// ExternalMergeSort : sorts files larger than RAM. Runs that fit the memory budget
+// are radix sorted and written to disk, then memory-mapped and k-way merged
+// through a loser tree while the OS reads ahead of every run cursor. Past
+// maxFanIn runs the merge takes several passes over intermediate runs.
+class ExternalMergeSort : public SortStrategy
 {
+    std::size_t memoryBudget;
+    std::vector<int> buffer;
+
+    static constexpr std::size_t maxOutputInts = 1 << 18;
+    static constexpr std::size_t maxFanIn = 64;
+    static constexpr std::size_t minPrefetchBytes = 16 << 10;
+    static constexpr std::size_t maxPrefetchBytes = 4 << 20;
+
+    struct RunCursor
+    {
+        MappedFile file;
+        const int* pos = nullptr;
+        const int* end = nullptr;
+        std::size_t nextPrefetch = 0;
+    };
+
+    static void removeRuns(const std::vector<std::string>& runs)
+    {
+        for(const std::string& run : runs)
+        {
+            std::remove(run.c_str());
+        }
+    }
+
+    // Each cursor keeps about three windows of its run resident : the one being
+    // read, the one prefetched ahead and the one not yet released.
+    bool mergeRuns(const std::vector<std::string>& runs, const std::string& output, std::size_t outputInts, std::size_t window)
+    {
+        std::vector<RunCursor> cursors(runs.size());
+        LoserTree tree(runs.size());
+        for(std::size_t i = 0; i < runs.size(); ++i)
+        {
+            RunCursor& c = cursors[i];
+            if(!c.file.open(runs[i]))
+            {
+                std::cout<<"could not map run "<<runs[i]<<std::endl;
+                return false;
+            }
+            c.pos = reinterpret_cast<const int*>(c.file.data());
+            c.end = c.pos + c.file.size() / sizeof(int);
+            c.file.prefetch(0, 2 * window);
+            c.nextPrefetch = window;
+            if(c.pos != c.end)
+            {
+                tree.set(i, *c.pos);
+            }
+        }
+        tree.init();
+
+        FILE* out = std::fopen(output.c_str(), "wb");
+        if(!out)
+        {
+            std::cout<<"could not write "<<output<<std::endl;
+            return false;
+        }
+        std::vector<int> pending(outputInts);
+        std::size_t filled = 0;
+        bool ok = true;
+        while(!tree.empty())
+        {
+            RunCursor& c = cursors[tree.winner()];
+            pending[filled++] = tree.top();
+            if(++c.pos != c.end)
+            {
+                tree.pushWinner(*c.pos);
+                std::size_t offset = reinterpret_cast<const unsigned char*>(c.pos) - c.file.data();
+                if(offset >= c.nextPrefetch)
+                {
+                    c.file.release(c.nextPrefetch - window, window);
+                    c.file.prefetch(c.nextPrefetch + window, window);
+                    c.nextPrefetch += window;
+                }
+            }
+            else
+            {
+                tree.dropWinner();
+            }
+            if(filled == outputInts)
+            {
+                ok = ok && std::fwrite(pending.data(), sizeof(int), filled, out) == filled;
+                filled = 0;
+            }
+        }
+        ok = ok && std::fwrite(pending.data(), sizeof(int), filled, out) == filled;
+        ok = std::fclose(out) == 0 && ok;
+        if(!ok)
+        {
+            std::cout<<"could not write "<<output<<std::endl;
+        }
+        return ok;
+    }
+
 public :
-    void sort(std::vector<int>& data) override 
+    static constexpr std::size_t minMemoryBudget = 64 << 10;
+
+    explicit ExternalMergeSort(std::size_t memoryBudgetBytes = std::size_t(256) << 20)
+        : memoryBudget(memoryBudgetBytes) {}
+
+    void sort(std::vector<int>& data) override
     {
-        std::cout<<"sorting using merge sort"<<std::endl;
-        // imagine MergeSort implementation here
+        std::cout<<"sorting using external merge sort (in memory)"<<std::endl;
+        buffer.resize(data.size());
+        sortalgo::radixSort(data.data(), data.size(), buffer.data());
+        std::vector<int>().swap(buffer);
+    }
+
+    bool sortFile(const std::string& input, const std::string& output) override
+    {
+        if(memoryBudget < minMemoryBudget)
+        {
+            std::cout<<"external sort : a memory budget of at least "<<minMemoryBudget<<" bytes is needed"<<std::endl;
+            return false;
+        }
+        FILE* in = std::fopen(input.c_str(), "rb");
+        if(!in)
+        {
+            std::cout<<"could not read "<<input<<std::endl;
+            return false;
+        }
+        // the merge output buffer takes at most a quarter of the budget, run data
+        // and its radix scratch share the rest
+        std::size_t outputInts = std::min(maxOutputInts, memoryBudget / 4 / sizeof(int));
+        std::size_t runInts = (memoryBudget - outputInts * sizeof(int)) / (2 * sizeof(int));
+
+        std::vector<int> run(runInts);
+        buffer.resize(runInts);
+        std::vector<std::string> runs;
+        bool ok = true;
+        bool whole = true;
+        while(ok)
+        {
+            std::size_t bytes = std::fread(run.data(), 1, runInts * sizeof(int), in);
+            whole = bytes % sizeof(int) == 0;
+            std::size_t got = bytes / sizeof(int);
+            if(got == 0 || !whole)
+            {
+                break;
+            }
+            sortalgo::radixSort(run.data(), got, buffer.data());
+            runs.push_back(output + ".run" + std::to_string(runs.size()));
+            ok = writeIntFile(runs.back(), run.data(), got);
+        }
+        bool readOk = !std::ferror(in);
+        std::fclose(in);
+        std::vector<int>().swap(run);
+        std::vector<int>().swap(buffer);
+        if(!ok || !readOk || !whole)
+        {
+            std::cout<<"external sort : "<<(!readOk ? "failed while reading input" : !whole ? "input size is not a multiple of the int size"
+                                                     : "failed while writing runs")<<std::endl;
+            removeRuns(runs);
+            return false;
+        }
+
+        // STEP : the run memory is free again and bounds what the merge reads ahead
+        std::size_t readAhead = memoryBudget - outputInts * sizeof(int);
+        std::size_t fanIn = std::min(maxFanIn, std::max<std::size_t>(2, readAhead / (3 * minPrefetchBytes)));
+        std::size_t window = std::min(maxPrefetchBytes, std::max<std::size_t>(4096, readAhead / (3 * fanIn) / 4096 * 4096));
+        std::cout<<"external sort : merging "<<runs.size()<<" runs of up to "<<runInts<<" ints, "<<fanIn<<" at a time"<<std::endl;
+
+        std::size_t nextRun = runs.size();
+        while(ok && runs.size() > fanIn)
+        {
+            std::vector<std::string> merged;
+            for(std::size_t first = 0; first < runs.size(); first += fanIn)
+            {
+                std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(first + fanIn, runs.size()));
+                merged.push_back(output + ".run" + std::to_string(nextRun++));
+                ok = ok && mergeRuns(group, merged.back(), outputInts, window);
+                removeRuns(group);
+            }
+            runs.swap(merged);
+        }
+        ok = ok && mergeRuns(runs, output, outputInts, window);
+        removeRuns(runs);
+        return ok;
     }
 };
 
 // Step3 : Context
-class Sorter 
+class Sorter
 {
 private :
     std::unique_ptr<SortStrategy> strategy;
+    std::vector<int> appendBuffer;
 public :
     void setStrategy(std::unique_ptr<SortStrategy> s)
     {
@@ -53,19 +1560,554 @@ public :
             std::cout<<"No sorting strategy set"<<std::endl;
         }
     }
+
+    bool sortFile(const std::string& input, const std::string& output)
+    {
+        if(strategy)
+        {
+            return strategy->sortFile(input, output);
+        }
+        std::cout<<"No sorting strategy set"<<std::endl;
+        return false;
+    }
+
+    // Selection modes : only the part of the order the caller asks for is computed.
+    void nthElement(std::vector<int>& data, std::size_t k)
+    {
+        if(!strategy)
+        {
+            std::cout<<"No sorting strategy set"<<std::endl;
+        }
+        else if(k < data.size())
+        {
+            strategy->nthElement(data, k);
+        }
+    }
+
+    void partialSort(std::vector<int>& data, std::size_t k)
+    {
+        if(!strategy)
+        {
+            std::cout<<"No sorting strategy set"<<std::endl;
+        }
+        else if(k >= data.size())
+        {
+            strategy->sort(data);
+        }
+        else if(k > 0)
+        {
+            strategy->partialSort(data, k);
+        }
+    }
+
+    // Incremental mode : data[0, sortedPrefix) is already sorted and only the
+    // elements appended after it are sorted and merged in, O(b log b + n)
+    // for a batch of b instead of a full O(n log n) re-sort.
+    void sortAppended(std::vector<int>& data, std::size_t sortedPrefix)
+    {
+        sortalgo::mergeAppended(data.data(), std::min(sortedPrefix, data.size()), data.size(), appendBuffer);
+    }
+
+    void appendBatch(std::vector<int>& data, const std::vector<int>& batch)
+    {
+        std::size_t sortedPrefix = data.size();
+        data.insert(data.end(), batch.begin(), batch.end());
+        sortAppended(data, sortedPrefix);
+    }
+
+    // The k largest values, largest first. data is reordered.
+    std::vector<int> topK(std::vector<int>& data, std::size_t k)
+    {
+        if(!strategy)
+        {
+            std::cout<<"No sorting strategy set"<<std::endl;
+            return {};
+        }
+        k = std::min(k, data.size());
+        if(k == 0)
+        {
+            return {};
+        }
+        std::size_t from = data.size() - k;
+        strategy->nthElement(data, from);
+        std::vector<int> top(data.begin() + from, data.end());
+        sortalgo::introSort(top.data(), top.data() + top.size(), std::greater<int>());
+        return top;
+    }
+};
+
+// Statically dispatched family for any element type and comparator. The
+// comparator is a template parameter, so it is inlined into the kernels
+// instead of being called through a virtual function or std::function.
+template<typename T, typename Compare = std::less<T>>
+class QuickSortT
+{
+    Compare comp;
+public :
+    explicit QuickSortT(Compare c = Compare()) : comp(c) {}
+
+    void sort(std::vector<T>& data)
+    {
+        sortalgo::introSort(data.data(), data.data() + data.size(), comp);
+    }
+};
+
+template<typename T, typename Compare = std::less<T>>
+class MergeSortT
+{
+    std::shared_ptr<ThreadPool> pool;
+    std::vector<T> buffer;
+    Compare comp;
+public :
+    explicit MergeSortT(unsigned threads = defaultThreads(), Compare c = Compare())
+        : pool(std::make_shared<ThreadPool>(threads)), comp(c) {}
+
+    void sort(std::vector<T>& data)
+    {
+        sortalgo::parallelMergeSort(*pool, data.data(), data.size(), buffer, comp);
+    }
+};
+
+template<typename T, typename Compare = std::less<T>>
+class RunMergeSortT
+{
+    std::vector<T> buffer;
+    Compare comp;
+public :
+    explicit RunMergeSortT(Compare c = Compare()) : comp(c) {}
+
+    void sort(std::vector<T>& data)
+    {
+        buffer.resize(data.size());
+        sortalgo::naturalMergeSort(data.data(), data.size(), buffer.data(), comp);
+    }
+};
+
+// Context with compile-time dispatch : std::visit picks the strategy once per
+// call and every comparison inside it is a direct, inlinable call.
+template<typename T, typename Compare = std::less<T>>
+class StaticSorter
+{
+public :
+    using Strategy = std::variant<QuickSortT<T, Compare>, MergeSortT<T, Compare>, RunMergeSortT<T, Compare>>;
+
+private :
+    Strategy strategy;
+
+public :
+    StaticSorter() = default;
+    explicit StaticSorter(Strategy s) : strategy(std::move(s)) {}
+
+    void setStrategy(Strategy s)
+    {
+        strategy = std::move(s);
+    }
+
+    void sortData(std::vector<T>& data)
+    {
+        std::visit([&data](auto& s) { s.sort(data); }, strategy);
+    }
+};
+
+// Silences the strategies' progress lines while measuring.
+class QuietCout
+{
+    std::streambuf* saved;
+public :
+    QuietCout() : saved(std::cout.rdbuf(nullptr)) {}
+    ~QuietCout() { std::cout.rdbuf(saved); }
+};
+
+template<typename F>
+double millis(F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct KeyValue
+{
+    std::uint64_t key;
+    std::uint64_t value;
+};
+
+struct ByKey
+{
+    bool operator()(const KeyValue& x, const KeyValue& y) const { return x.key < y.key; }
+};
+
+// Virtual int path vs static int path, then 64-bit key/value records sorted with a
+// type-erased comparator (what a runtime-generic SortStrategy needs) vs an inlined one.
+void benchmarkDispatch(std::size_t n)
+{
+    std::mt19937_64 rng(42);
+    std::vector<int> ints(n);
+    for(int& v : ints)
+    {
+        v = static_cast<int>(rng());
+    }
+    std::vector<KeyValue> records(n);
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        records[i] = {rng(), i};
+    }
+
+    double virtualInts, staticInts, erasedRecords, staticRecords;
+    {
+        QuietCout quiet;
+        std::vector<int> a = ints;
+        Sorter sorter;
+        sorter.setStrategy(std::make_unique<QuickSort>());
+        virtualInts = millis([&]{ sorter.sortData(a); });
+
+        std::vector<int> b = ints;
+        StaticSorter<int> staticSorter{QuickSortT<int>()};
+        staticInts = millis([&]{ staticSorter.sortData(b); });
+
+        using ErasedCompare = std::function<bool(const KeyValue&, const KeyValue&)>;
+        std::vector<KeyValue> c = records;
+        StaticSorter<KeyValue, ErasedCompare> erasedSorter{QuickSortT<KeyValue, ErasedCompare>(ByKey())};
+        erasedRecords = millis([&]{ erasedSorter.sortData(c); });
+
+        std::vector<KeyValue> d = records;
+        StaticSorter<KeyValue, ByKey> inlinedSorter{QuickSortT<KeyValue, ByKey>()};
+        staticRecords = millis([&]{ inlinedSorter.sortData(d); });
+    }
+
+    std::cout<<"n = "<<n<<std::endl;
+    std::cout<<"int, virtual Sorter          : "<<virtualInts<<" ms"<<std::endl;
+    std::cout<<"int, StaticSorter            : "<<staticInts<<" ms"<<std::endl;
+    std::cout<<"key/value, erased comparator : "<<erasedRecords<<" ms"<<std::endl;
+    std::cout<<"key/value, inlined comparator: "<<staticRecords<<" ms ("
+             <<erasedRecords / staticRecords<<"x faster)"<<std::endl;
+}
+
+// Benchmark suite : every strategy over every input shape and size, written as JSON.
+enum class Distribution { Uniform, Sorted, Reversed, Sawtooth, FewUnique, Zipf };
+
+const char* distributionName(Distribution d)
+{
+    switch(d)
+    {
+        case Distribution::Uniform : return "uniform";
+        case Distribution::Sorted : return "sorted";
+        case Distribution::Reversed : return "reversed";
+        case Distribution::Sawtooth : return "sawtooth";
+        case Distribution::FewUnique : return "few_unique";
+        case Distribution::Zipf : return "zipf";
+    }
+    return "unknown";
+}
+
+std::vector<int> generateInput(Distribution d, std::size_t n, std::mt19937_64& rng)
+{
+    std::vector<int> data(n);
+    switch(d)
+    {
+        case Distribution::Uniform :
+            for(int& v : data) v = static_cast<int>(rng());
+            break;
+        case Distribution::Sorted :
+            for(std::size_t i = 0; i < n; ++i) data[i] = static_cast<int>(i);
+            break;
+        case Distribution::Reversed :
+            for(std::size_t i = 0; i < n; ++i) data[i] = static_cast<int>(n - i);
+            break;
+        case Distribution::Sawtooth :
+        {
+            std::size_t tooth = std::max<std::size_t>(16, n / 64);
+            for(std::size_t i = 0; i < n; ++i) data[i] = static_cast<int>(i % tooth);
+            break;
+        }
+        case Distribution::FewUnique :
+            for(int& v : data) v = static_cast<int>(rng() % 16);
+            break;
+        case Distribution::Zipf :
+        {
+            // s = 1.1 over 2^20 ranks, ranks scattered over the int range by a multiplicative hash
+            const std::size_t ranks = 1 << 20;
+            std::vector<double> cdf(ranks);
+            double sum = 0.0;
+            for(std::size_t r = 0; r < ranks; ++r)
+            {
+                sum += 1.0 / std::pow(double(r + 1), 1.1);
+                cdf[r] = sum;
+            }
+            std::uniform_real_distribution<double> uniform(0.0, sum);
+            for(int& v : data)
+            {
+                std::size_t r = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+                v = static_cast<int>(static_cast<std::uint32_t>(r * 2654435761u));
+            }
+            break;
+        }
+    }
+    return data;
+}
+
+struct BenchResult
+{
+    std::string strategy;
+    unsigned threads;
+    Distribution distribution;
+    std::size_t n;
+    int reps;
+    double bestNs;
+    double meanNs;
+    bool sorted;
 };
 
-int main()
+// sizes 1K, 10K, ... up to maxN; every parallel strategy also runs on 1, 2, 4, ... threads
+void benchmarkSuite(std::size_t maxN, std::ostream& out)
+{
+    const char* benchInput = "bench_input.bin";
+    const char* benchOutput = "bench_output.bin";
+    auto readBack = [](const char* path, std::vector<int>& data)
+    {
+        FILE* f = std::fopen(path, "rb");
+        if(!f)
+        {
+            return false;
+        }
+        std::fseek(f, 0, SEEK_END);
+        data.resize(static_cast<std::size_t>(std::ftell(f)) / sizeof(int));
+        std::fseek(f, 0, SEEK_SET);
+        bool ok = std::fread(data.data(), sizeof(int), data.size(), f) == data.size();
+        std::fclose(f);
+        return ok;
+    };
+    struct Candidate
+    {
+        std::string name;
+        unsigned threads;
+        std::function<std::unique_ptr<SortStrategy>()> make;
+        bool fromFile = false;  // timed through sortFile() on a file holding the input
+    };
+    std::vector<Candidate> candidates = {
+        {"QuickSort", 1, []{ return std::unique_ptr<SortStrategy>(new QuickSort()); }},
+        {"RadixSort", 1, []{ return std::unique_ptr<SortStrategy>(new RadixSort()); }},
+        // a 4 MB budget, so the larger inputs are sorted in several runs
+        {"ExternalMergeSort", 1, []{ return std::unique_ptr<SortStrategy>(new ExternalMergeSort(4 << 20)); }, true},
+    };
+    std::vector<unsigned> threadCounts;
+    for(unsigned t = 1; t < defaultThreads(); t *= 2)
+    {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(defaultThreads());
+    for(unsigned t : threadCounts)
+    {
+        candidates.push_back({"MergeSort", t, [t]{ return std::unique_ptr<SortStrategy>(new MergeSort(t)); }});
+        candidates.push_back({"AutoSort", t, [t]{ return std::unique_ptr<SortStrategy>(new AutoSort(t)); }});
+    }
+
+    const Distribution distributions[] = {Distribution::Uniform, Distribution::Sorted, Distribution::Reversed,
+                                          Distribution::Sawtooth, Distribution::FewUnique, Distribution::Zipf};
+    std::vector<BenchResult> results;
+    std::mt19937_64 rng(2024);
+    {
+        QuietCout quiet;
+        for(std::size_t n = 1000; n <= maxN; n *= 10)
+        {
+            for(Distribution d : distributions)
+            {
+                const std::vector<int> input = generateInput(d, n, rng);
+                FILE* f = std::fopen(benchInput, "wb");
+                bool written = f && std::fwrite(input.data(), sizeof(int), n, f) == n;
+                written = f && std::fclose(f) == 0 && written;
+                for(const Candidate& c : candidates)
+                {
+                    if(c.fromFile && !written)
+                    {
+                        continue;
+                    }
+                    std::unique_ptr<SortStrategy> strategy = c.make();
+                    std::vector<int> work;
+                    BenchResult r{c.name, c.threads, d, n, 0, 0.0, 0.0, true};
+                    double total = 0.0;
+                    double best = 0.0;
+                    // small inputs are repeated until about 200 ms were measured
+                    while(r.reps < 3 || (total < 200.0 && r.reps < 1000))
+                    {
+                        double ms;
+                        if(c.fromFile)
+                        {
+                            bool ok = false;
+                            ms = millis([&]{ ok = strategy->sortFile(benchInput, benchOutput); });
+                            r.sorted = r.sorted && ok && readBack(benchOutput, work) && work.size() == n;
+                        }
+                        else
+                        {
+                            work = input;
+                            ms = millis([&]{ strategy->sort(work); });
+                        }
+                        r.sorted = r.sorted && std::is_sorted(work.begin(), work.end());
+                        best = r.reps == 0 ? ms : std::min(best, ms);
+                        total += ms;
+                        ++r.reps;
+                    }
+                    r.bestNs = best * 1e6 / n;
+                    r.meanNs = total * 1e6 / r.reps / n;
+                    results.push_back(r);
+                }
+            }
+        }
+        std::remove(benchInput);
+        std::remove(benchOutput);
+    }
+
+    out<<"{\n  \"benchmark\": \"sort\",\n  \"hardware_threads\": "<<defaultThreads()<<",\n  \"results\": [";
+    for(std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+        double speedup = 1.0;
+        for(const BenchResult& base : results)
+        {
+            if(base.strategy == r.strategy && base.threads == 1 && base.distribution == r.distribution && base.n == r.n)
+            {
+                speedup = base.bestNs / r.bestNs;
+            }
+        }
+        out<<(i ? ",\n" : "\n")
+           <<"    {\"strategy\": \""<<r.strategy<<"\", \"threads\": "<<r.threads
+           <<", \"distribution\": \""<<distributionName(r.distribution)<<"\", \"n\": "<<r.n
+           <<", \"reps\": "<<r.reps<<", \"ns_per_element\": "<<r.bestNs
+           <<", \"mean_ns_per_element\": "<<r.meanNs
+           <<", \"elements_per_second\": "<<1e9 / r.bestNs
+           <<", \"mb_per_second\": "<<1e3 * sizeof(int) / r.bestNs
+           <<", \"speedup_vs_1_thread\": "<<speedup
+           <<", \"sorted\": "<<(r.sorted ? "true" : "false")<<"}";
+    }
+    out<<"\n  ]\n}\n";
+}
+
+void printData(const std::vector<int>& data)
 {
+    for(int value : data)
+    {
+        std::cout<<value<<" ";
+    }
+    std::cout<<std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc > 1 && std::string(argv[1]) == "bench-dispatch")
+    {
+        benchmarkDispatch(argc > 2 ? std::stoull(argv[2]) : std::size_t(1) << 22);
+        return 0;
+    }
+    // bench [maxN] [out.json] : 1K up to maxN elements (default 10M), JSON to stdout or a file
+    if(argc > 1 && std::string(argv[1]) == "bench")
+    {
+        std::size_t maxN = argc > 2 ? std::stoull(argv[2]) : 10000000;
+        if(argc > 3)
+        {
+            std::ofstream file(argv[3]);
+            benchmarkSuite(maxN, file);
+        }
+        else
+        {
+            benchmarkSuite(maxN, std::cout);
+        }
+        return 0;
+    }
+
     std::vector<int> data = {5,4,3,2,4};
 
     Sorter sorter;
 
     sorter.setStrategy(std::make_unique<QuickSort>());
     sorter.sortData(data);
+    printData(data);
 
+    data = {9,1,8,2,7,3,6,4,5};
     sorter.setStrategy(std::make_unique<MergeSort>());
     sorter.sortData(data);
-    
+    printData(data);
+
+    data = {-3,100000,7,-250000,0,42,7};
+    sorter.setStrategy(std::make_unique<RadixSort>());
+    sorter.sortData(data);
+    printData(data);
+
+    // auto mode picks the kernel from a sample of the data
+    sorter.setStrategy(std::make_unique<AutoSort>());
+    data = {3,1,2};
+    sorter.sortData(data);
+    printData(data);
+
+    data.resize(100000);
+    for(std::size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<int>(data.size() - i);
+    }
+    sorter.sortData(data);
+    std::cout<<"first "<<data.front()<<" last "<<data.back()<<std::endl;
+
+    // top-k and selection without a full sort
+    data.resize(1000000);
+    for(std::size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<int>((i * 2654435761u) % 1000003);
+    }
+    sorter.setStrategy(std::make_unique<MergeSort>());
+    std::vector<int> top = sorter.topK(data, 5);
+    std::cout<<"top 5 : ";
+    printData(top);
+
+    sorter.setStrategy(std::make_unique<QuickSort>());
+    sorter.nthElement(data, data.size() / 2);
+    std::cout<<"median : "<<data[data.size() / 2]<<std::endl;
+    sorter.partialSort(data, 5);
+    std::cout<<"smallest 5 : "<<data[0]<<" "<<data[1]<<" "<<data[2]<<" "<<data[3]<<" "<<data[4]<<std::endl;
+
+    // incremental mode : batches are merged into the already sorted data
+    std::vector<int> stream = {1, 4, 9};
+    sorter.appendBatch(stream, {7, 2, 8});
+    sorter.appendBatch(stream, {10, 11});
+    sorter.appendBatch(stream, {0, 5, 3});
+    printData(stream);
+
+    // many short arrays sorted in one call (build with -mavx2 for the SIMD networks)
+    std::vector<int> values = {3,1,2, 9,8,7,6, 5,5,4};
+    std::vector<std::size_t> offsets = {0, 3, 7, 10};
+    sortalgo::sortSmallArrays(values.data(), offsets.data(), offsets.size() - 1);
+    printData(values);
+
+    // generic, statically dispatched path : 64-bit keys sorted in descending order
+    std::vector<long long> keys = {5000000000LL, -7, 42, 9000000000LL, 0};
+    StaticSorter<long long, std::greater<long long>> keySorter;
+    keySorter.setStrategy(RunMergeSortT<long long, std::greater<long long>>());
+    keySorter.sortData(keys);
+    for(long long key : keys)
+    {
+        std::cout<<key<<" ";
+    }
+    std::cout<<std::endl;
+
+    // file sort with a 1 MB budget : the 4 MB input is sorted in several runs
+    data.resize(1 << 20);
+    for(std::size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<int>((i * 2654435761u) % 1000003);
+    }
+    FILE* f = std::fopen("numbers.bin", "wb");
+    std::fwrite(data.data(), sizeof(int), data.size(), f);
+    std::fclose(f);
+
+    sorter.setStrategy(std::make_unique<ExternalMergeSort>(1 << 20));
+    if(sorter.sortFile("numbers.bin", "numbers_sorted.bin"))
+    {
+        f = std::fopen("numbers_sorted.bin", "rb");
+        std::size_t got = std::fread(data.data(), sizeof(int), data.size(), f);
+        std::fclose(f);
+        std::cout<<"read back "<<got<<" ints, sorted : "<<std::boolalpha
+                 <<std::is_sorted(data.begin(), data.end())<<std::endl;
+    }
+    std::remove("numbers.bin");
+    std::remove("numbers_sorted.bin");
+
     return 0;
-}
\ No newline at end of file
+}
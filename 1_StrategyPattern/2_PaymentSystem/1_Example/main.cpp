@@ -39,7 +39,7 @@ class UpiPayment : public PaymentStrategy
 {
     std::string upiId;
 public :
-    UpiPayment(std::string upiId_) : upiId(upiId) {}
+    UpiPayment(std::string upiId_) : upiId(upiId_) {}
 
     void pay(double amount) override 
     {
@@ -1,77 +1,2181 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <future>
+#include <atomic>
+#include <bitset>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../../Money.h"
+
+enum class PaymentChannel : std::uint8_t { CreditCard, Paypal, Upi };
+constexpr std::size_t channelCount = 3;
+
+inline const char* channelName(PaymentChannel c)
+{
+    switch(c)
+    {
+        case PaymentChannel::CreditCard : return "CreditCard";
+        case PaymentChannel::Paypal : return "Paypal";
+        case PaymentChannel::Upi : return "Upi";
+    }
+    return "Unknown";
+}
+
+// One payment in a batch. account points into caller-owned storage, nothing is copied.
+struct PaymentRecord
+{
+    PaymentChannel channel;
+    Money amount;
+    std::string_view account;
+    std::uint64_t idempotencyKey = 0;  // 0 : not deduplicated
+    std::uint64_t reference = 0;       // merchant reference sent to the gateway, 0 : not assigned yet
+};
+
+// Merchant reference of a payment : the gateway echoes it in its settlement
+// file, which is what reconciliation joins the ledger on. A payment with an
+// idempotency key reuses the key, so every retry of an order carries the same
+// reference; anything else gets a fresh one, seeded from the clock so that
+// references stay unique across restarts.
+inline std::uint64_t merchantReference(std::uint64_t idempotencyKey)
+{
+    static std::atomic<std::uint64_t> next{static_cast<std::uint64_t>(std::chrono::system_clock::now().time_since_epoch().count())};
+    std::uint64_t reference = idempotencyKey;
+    while(reference == 0)
+    {
+        // splitmix64 finalizer : a bijection, so distinct counter values never collide
+        std::uint64_t z = next++ * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        reference = z ^ (z >> 31);
+    }
+    return reference;
+}
+
+struct SettlementSummary
+{
+    std::size_t count = 0;
+    Money total;
+
+    SettlementSummary& operator+=(const SettlementSummary& other)
+    {
+        count += other.count;
+        total += other.total;
+        return *this;
+    }
+};
+
+// Account checks run before a record reaches any strategy. Each check has an
+// SSE2 kernel and a scalar fallback with the same result.
+namespace validation
+{
+    constexpr std::size_t maxAccountLength = 256;
+    using CharMask = std::bitset<maxAccountLength>;
+
+    // One bit per byte of the account for each character class it needs.
+    struct CharClasses
+    {
+        CharMask alnum, at, dot, dash, underscore, plusPercent;
+    };
+
+    inline CharClasses classify(std::string_view s)
+    {
+        CharClasses cls;
+#if defined(__SSE2__) || defined(_M_X64)
+        for(std::size_t off = 0; off < s.size(); off += 16)
+        {
+            alignas(16) unsigned char block[16] = {};
+            std::memcpy(block, s.data() + off, std::min<std::size_t>(16, s.size() - off));
+            __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+            __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+            __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+            auto bits = [off](__m128i m)
+            {
+                return CharMask(static_cast<unsigned>(_mm_movemask_epi8(m))) << off;
+            };
+            cls.alnum |= bits(_mm_or_si128(alpha, digit));
+            cls.at |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('@')));
+            cls.dot |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('.')));
+            cls.dash |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+            cls.underscore |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+            cls.plusPercent |= bits(_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('+')), _mm_cmpeq_epi8(c, _mm_set1_epi8('%'))));
+        }
+#else
+        for(std::size_t i = 0; i < s.size(); ++i)
+        {
+            char c = s[i];
+            char lower = static_cast<char>(c | 0x20);
+            cls.alnum[i] = (lower >= 'a' && lower <= 'z') || (c >= '0' && c <= '9');
+            cls.at[i] = c == '@';
+            cls.dot[i] = c == '.';
+            cls.dash[i] = c == '-';
+            cls.underscore[i] = c == '_';
+            cls.plusPercent[i] = c == '+' || c == '%';
+        }
+#endif
+        return cls;
+    }
+
+    // Bits [0, n)
+    inline CharMask firstBits(std::size_t n)
+    {
+        return n >= maxAccountLength ? ~CharMask() : ~(~CharMask() << n);
+    }
+
+    // Finds the single '@' : returns false when there is not exactly one.
+    inline bool splitAt(std::string_view s, const CharClasses& cls, std::size_t& at)
+    {
+        if(cls.at.count() != 1)
+        {
+            return false;
+        }
+        at = s.find('@');
+        return true;
+    }
+
+    // UPI virtual payment address : handle@psp, handle of letters, digits, '.', '-', '_'
+    // and a letters-and-digits PSP name, both at least two characters.
+    inline bool upiValid(std::string_view id)
+    {
+        if(id.size() < 5 || id.size() > 64)
+        {
+            return false;
+        }
+        CharClasses cls = classify(id);
+        std::size_t at;
+        if(!splitAt(id, cls, at) || at < 2 || id.size() - at - 1 < 2)
+        {
+            return false;
+        }
+        CharMask handle = firstBits(at);
+        CharMask psp = firstBits(id.size()) & ~firstBits(at + 1);
+        CharMask handleChars = cls.alnum | cls.dot | cls.dash | cls.underscore;
+        return (handle & ~handleChars).none() && (psp & ~cls.alnum).none();
+    }
+
+    // PayPal login : local@domain with a dotted domain, no empty labels.
+    inline bool emailValid(std::string_view email)
+    {
+        if(email.size() < 6 || email.size() > 254)
+        {
+            return false;
+        }
+        CharClasses cls = classify(email);
+        std::size_t at;
+        if(!splitAt(email, cls, at) || at == 0 || at + 4 > email.size())
+        {
+            return false;
+        }
+        CharMask local = firstBits(at);
+        CharMask domain = firstBits(email.size()) & ~firstBits(at + 1);
+        CharMask localChars = cls.alnum | cls.dot | cls.dash | cls.underscore | cls.plusPercent;
+        CharMask domainChars = cls.alnum | cls.dot | cls.dash;
+        if((local & ~localChars).any() || (domain & ~domainChars).any() || (domain & cls.dot).none())
+        {
+            return false;
+        }
+        // no leading, trailing or doubled dots in either part
+        CharMask edges = CharMask().set(0).set(at - 1).set(at + 1).set(email.size() - 1);
+        return (cls.dot & (edges | (cls.dot >> 1))).none();
+    }
+
+    // Luhn checksum over 12 to 19 digits. Spaces and dashes between digit groups are ignored.
+    inline bool luhnValid(std::string_view card)
+    {
+        // digits right-aligned in 32 bytes, zero padded : index 31 is the check digit
+        alignas(16) unsigned char digits[32];
+        std::memset(digits, '0', sizeof(digits));
+        std::size_t n = 0;
+        if(card.size() >= 12 && card.size() <= 19 && card.find_first_of(" -") == std::string_view::npos)
+        {
+            n = card.size();
+            std::memcpy(digits + 32 - n, card.data(), n);
+        }
+        else
+        {
+            for(std::size_t i = card.size(); i-- > 0;)
+            {
+                if(card[i] == ' ' || card[i] == '-')
+                {
+                    continue;
+                }
+                if(n == 19)
+                {
+                    return false;
+                }
+                digits[31 - n++] = static_cast<unsigned char>(card[i]);
+            }
+            if(n < 12)
+            {
+                return false;
+            }
+        }
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i nine = _mm_set1_epi8(9);
+        // every other digit from the right is doubled : the even indices
+        const __m128i doubled = _mm_set1_epi16(0x00FF);
+        __m128i sum = zero;
+        int allDigits = 0xFFFF;
+        for(int half = 0; half < 2; ++half)
+        {
+            __m128i d = _mm_sub_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(digits + 16 * half)), _mm_set1_epi8('0'));
+            allDigits &= _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(d, nine), nine));
+            __m128i twice = _mm_sub_epi8(_mm_add_epi8(d, d), _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(4)), nine));
+            __m128i w = _mm_or_si128(_mm_and_si128(doubled, twice), _mm_andnot_si128(doubled, d));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(w, zero));
+        }
+        if(allDigits != 0xFFFF)
+        {
+            return false;
+        }
+        int total = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+#else
+        int total = 0;
+        for(int i = 0; i < 32; ++i)
+        {
+            int d = digits[i] - '0';
+            if(d < 0 || d > 9)
+            {
+                return false;
+            }
+            if(i % 2 == 0)
+            {
+                d = d > 4 ? d * 2 - 9 : d * 2;
+            }
+            total += d;
+        }
+#endif
+        return total % 10 == 0;
+    }
+
+    inline bool accountValid(PaymentChannel channel, std::string_view account)
+    {
+        switch(channel)
+        {
+            case PaymentChannel::CreditCard : return luhnValid(account);
+            case PaymentChannel::Paypal : return emailValid(account);
+            case PaymentChannel::Upi : return upiValid(account);
+        }
+        return false;
+    }
+
+    // Writes 1 for each valid record and 0 otherwise; returns the number rejected.
+    inline std::size_t validateBatch(const PaymentRecord* records, std::size_t count, std::uint8_t* valid)
+    {
+        std::size_t rejected = 0;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            valid[i] = records[i].amount > Money() && accountValid(records[i].channel, records[i].account);
+            rejected += !valid[i];
+        }
+        return rejected;
+    }
+}
+
+// Fixed set of worker threads fed from a bounded queue. submit() blocks while
+// the queue is full, so producers are slowed down instead of piling up work.
+class WorkerPool
+{
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::size_t capacity;
+    bool stopping = false;
+
+public :
+    WorkerPool(unsigned threads, std::size_t queueCapacity) : capacity(queueCapacity)
+    {
+        for(unsigned i = 0; i < threads; ++i)
+        {
+            workers.emplace_back([this]
+            {
+                while(true)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mtx);
+                        notEmpty.wait(lock, [this]{ return stopping || !tasks.empty(); });
+                        if(tasks.empty())
+                        {
+                            return;
+                        }
+                        task = std::move(tasks.front());
+                        tasks.pop_front();
+                    }
+                    notFull.notify_one();
+                    task();
+                }
+            });
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        notEmpty.notify_all();
+        for(std::thread& t : workers)
+        {
+            t.join();
+        }
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            notFull.wait(lock, [this]{ return tasks.size() < capacity; });
+            tasks.push_back(std::move(task));
+        }
+        notEmpty.notify_one();
+    }
+};
+
+// Counts outstanding tasks of one job so the submitter can wait for just those.
+class TaskGroup
+{
+    std::mutex mtx;
+    std::condition_variable allDone;
+    std::size_t pending = 0;
+public :
+    void add(std::size_t n = 1)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending += n;
+    }
+
+    void done()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(--pending == 0)
+        {
+            allDone.notify_all();
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        allDone.wait(lock, [this]{ return pending == 0; });
+    }
+};
+
+// Unrecorded : approved and charged, but the ledger write failed; needs reconciliation.
+enum class PaymentStatus : std::uint8_t { Approved, Declined, Duplicate, Rejected, Unrecorded };
+
+inline const char* statusName(PaymentStatus s)
+{
+    switch(s)
+    {
+        case PaymentStatus::Approved : return "Approved";
+        case PaymentStatus::Declined : return "Declined";
+        case PaymentStatus::Duplicate : return "Duplicate";
+        case PaymentStatus::Rejected : return "Rejected";
+        case PaymentStatus::Unrecorded : return "Unrecorded";
+    }
+    return "Unknown";
+}
+
+// Remote side of a payment. charge() blocks for the round trip.
+class PaymentGateway
+{
+public :
+    virtual PaymentStatus charge(PaymentChannel channel, std::string_view account, Money amount, std::uint64_t reference) = 0;
+    virtual ~PaymentGateway() = default;
+};
+
+// In-process stand-in for a real gateway : sleeps for a fixed latency and
+// tracks how many charges are in flight at once.
+class LoopbackGateway : public PaymentGateway
+{
+    std::chrono::microseconds latency;
+    std::atomic<std::size_t> inFlight{0};
+    std::atomic<std::size_t> peak{0};
+    std::atomic<std::size_t> charged{0};
+public :
+    explicit LoopbackGateway(std::chrono::microseconds latency_) : latency(latency_) {}
+
+    PaymentStatus charge(PaymentChannel, std::string_view account, Money amount, std::uint64_t) override
+    {
+        std::size_t now = ++inFlight;
+        std::size_t seen = peak.load(std::memory_order_relaxed);
+        while(now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed))
+        {
+        }
+        std::this_thread::sleep_for(latency);
+        --inFlight;
+        ++charged;
+        return (amount > Money() && !account.empty()) ? PaymentStatus::Approved : PaymentStatus::Declined;
+    }
+
+    std::size_t peakInFlight() const { return peak.load(); }
+    std::size_t totalCharged() const { return charged.load(); }
+};
+
+// Remembers recently seen idempotency keys so client retries are not charged twice.
+// Open addressing over 64-bit key hashes, split into shards with one mutex each.
+// Memory is fixed at construction : when a key's probe window is full, the
+// entry that expires soonest is evicted.
+class IdempotencyCache
+{
+    struct Slot
+    {
+        std::uint64_t key = 0;   // 0 : empty
+        std::int64_t expires = 0;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mtx;
+        std::vector<Slot> slots;
+    };
+
+    static constexpr std::size_t shardCount = 64;
+    static constexpr std::size_t probeWindow = 32;
+
+    std::unique_ptr<Shard[]> shards;
+    std::size_t slotMask;
+    std::int64_t ttl;
+
+    static std::int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static std::uint64_t mix(std::uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+public :
+    IdempotencyCache(std::size_t capacity, std::chrono::milliseconds ttl_)
+        : shards(new Shard[shardCount]),
+          ttl(std::chrono::duration_cast<std::chrono::nanoseconds>(ttl_).count())
+    {
+        // at most half full when holding `capacity` live keys, so evictions stay rare
+        std::size_t perShard = probeWindow;
+        while(perShard * shardCount < capacity * 2)
+        {
+            perShard *= 2;
+        }
+        slotMask = perShard - 1;
+        for(std::size_t i = 0; i < shardCount; ++i)
+        {
+            shards[i].slots.resize(perShard);
+        }
+    }
+
+    // FNV-1a of the client's key; never returns 0.
+    static std::uint64_t keyOf(std::string_view key)
+    {
+        std::uint64_t h = 14695981039346656037ULL;
+        for(char c : key)
+        {
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        return h ? h : 1;
+    }
+
+    // Returns true and remembers the key if it was not seen within the TTL,
+    // false if this is a repeat.
+    bool tryClaim(std::uint64_t key)
+    {
+        std::uint64_t h = mix(key);
+        Shard& shard = shards[h & (shardCount - 1)];
+        std::size_t home = (h >> 6) & slotMask;
+        std::int64_t t = now();
+
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        Slot* target = nullptr;
+        for(std::size_t i = 0; i < probeWindow; ++i)
+        {
+            Slot& slot = shard.slots[(home + i) & slotMask];
+            if(slot.key == key)
+            {
+                if(slot.expires > t)
+                {
+                    return false;
+                }
+                target = &slot;
+                break;
+            }
+            if(slot.key == 0)
+            {
+                // entries are replaced in place, never moved, so the key cannot be further on
+                if(!target || target->expires > t)
+                {
+                    target = &slot;
+                }
+                break;
+            }
+            if(!target || slot.expires < target->expires)
+            {
+                target = &slot;
+            }
+        }
+        target->key = key;
+        target->expires = t + ttl;
+        return true;
+    }
+
+    // Forgets a claimed key so a failed payment can be retried with it.
+    void release(std::uint64_t key)
+    {
+        std::uint64_t h = mix(key);
+        Shard& shard = shards[h & (shardCount - 1)];
+        std::size_t home = (h >> 6) & slotMask;
+
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        for(std::size_t i = 0; i < probeWindow; ++i)
+        {
+            Slot& slot = shard.slots[(home + i) & slotMask];
+            if(slot.key == key)
+            {
+                slot.expires = 0;
+                return;
+            }
+            if(slot.key == 0)
+            {
+                return;
+            }
+        }
+    }
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+    const unsigned char* ptr = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public :
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        length = static_cast<std::size_t>(size.QuadPart);
+        if(length == 0)
+        {
+            return true;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping == nullptr)
+        {
+            return false;
+        }
+        ptr = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return ptr != nullptr;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0)
+        {
+            return false;
+        }
+        length = static_cast<std::size_t>(st.st_size);
+        if(length == 0)
+        {
+            return true;
+        }
+        void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            return false;
+        }
+        ptr = static_cast<const unsigned char*>(p);
+        madvise(p, length, MADV_SEQUENTIAL);
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if(ptr) UnmapViewOfFile(ptr);
+        if(mapping) CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if(ptr) munmap(const_cast<unsigned char*>(ptr), length);
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        ptr = nullptr;
+        length = 0;
+    }
+
+    const unsigned char* data() const { return ptr; }
+    std::size_t size() const { return length; }
+};
+
+// Ledger file layout : one LedgerHeader followed by fixed size LedgerEntry records.
+struct LedgerHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+};
+
+struct LedgerEntry
+{
+    std::uint64_t txnId;
+    std::int64_t timestamp;  // ns since the Unix epoch
+    std::int64_t amountPaise;
+    std::uint64_t reference;  // merchant reference the gateway was charged with
+    std::uint8_t channel;
+    std::uint8_t reserved[7];
+};
+
+constexpr char ledgerMagic[8] = {'P', 'A', 'Y', 'L', 'E', 'D', 'G', 'R'};
+constexpr std::uint32_t ledgerVersion = 3;  // 2 : amounts in paise, 3 : merchant reference
+static_assert(sizeof(LedgerHeader) == 16 && sizeof(LedgerEntry) == 40, "ledger layout is part of the file format");
+
+// Append-only payment ledger. Writers that arrive while a sync is running
+// queue their entries; the next writer to find the file idle becomes the
+// leader and writes and syncs everything queued with a single fsync.
+// append() returns only once the caller's entries are durable.
+class PaymentLedger
+{
+    int fd = -1;
+    std::mutex mtx;
+    std::condition_variable synced;
+    std::vector<LedgerEntry> pending;
+    std::vector<LedgerEntry> writing;
+    std::uint64_t nextTxn = 1;
+    std::uint64_t openBatch = 1;     // batch that new entries join
+    std::uint64_t durableBatch = 0;  // last batch on disk
+    bool flushing = false;
+    bool failed = false;
+    std::size_t syncs = 0;
+
+    static bool writeAll(int f, const void* data, std::size_t len)
+    {
+        const char* p = static_cast<const char*>(data);
+        while(len > 0)
+        {
+#ifdef _WIN32
+            int n = _write(f, p, static_cast<unsigned>(std::min<std::size_t>(len, 1u << 30)));
+#else
+            ssize_t n = ::write(f, p, len);
+#endif
+            if(n <= 0)
+            {
+                return false;
+            }
+            p += n;
+            len -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    static bool syncFile(int f)
+    {
+#ifdef _WIN32
+        return _commit(f) == 0;
+#elif defined(__linux__)
+        return fdatasync(f) == 0;
+#else
+        return fsync(f) == 0;
+#endif
+    }
+
+    static std::int64_t wallClock()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+public :
+    PaymentLedger() = default;
+    PaymentLedger(const PaymentLedger&) = delete;
+    PaymentLedger& operator=(const PaymentLedger&) = delete;
+    ~PaymentLedger() { close(); }
+
+    // Creates the file or reopens an existing ledger and continues its txn ids.
+    // A torn record left by a crash is cut off.
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        fd = _open(path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY | _O_APPEND, _S_IREAD | _S_IWRITE);
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+#endif
+        if(fd < 0)
+        {
+            return false;
+        }
+#ifdef _WIN32
+        long long size = _lseeki64(fd, 0, SEEK_END);
+#else
+        long long size = lseek(fd, 0, SEEK_END);
+#endif
+        LedgerHeader header;
+        if(size == 0)
+        {
+            std::copy(ledgerMagic, ledgerMagic + 8, header.magic);
+            header.version = ledgerVersion;
+            header.recordSize = sizeof(LedgerEntry);
+            if(!writeAll(fd, &header, sizeof(header)) || !syncFile(fd))
+            {
+                close();
+                return false;
+            }
+            size = sizeof(header);
+        }
+        else
+        {
+#ifdef _WIN32
+            _lseeki64(fd, 0, SEEK_SET);
+            bool read = _read(fd, &header, sizeof(header)) == static_cast<int>(sizeof(header));
+#else
+            bool read = pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+#endif
+            if(!read || !std::equal(ledgerMagic, ledgerMagic + 8, header.magic) ||
+               header.version != ledgerVersion || header.recordSize != sizeof(LedgerEntry))
+            {
+                close();
+                return false;
+            }
+        }
+        long long records = (size - static_cast<long long>(sizeof(header))) / static_cast<long long>(sizeof(LedgerEntry));
+        long long whole = static_cast<long long>(sizeof(header)) + records * static_cast<long long>(sizeof(LedgerEntry));
+        if(whole != size)
+        {
+#ifdef _WIN32
+            _chsize_s(fd, whole);
+#else
+            if(ftruncate(fd, whole) != 0)
+            {
+                close();
+                return false;
+            }
+#endif
+        }
+        nextTxn = static_cast<std::uint64_t>(records) + 1;
+        return true;
+    }
+
+    void close()
+    {
+        if(fd >= 0)
+        {
+#ifdef _WIN32
+            _close(fd);
+#else
+            ::close(fd);
+#endif
+        }
+        fd = -1;
+    }
+
+    // Records the batch durably and returns the txn id of its first entry, 0 on I/O failure.
+    std::uint64_t append(const PaymentRecord* records, std::size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if(failed || fd < 0)
+        {
+            return 0;
+        }
+        std::uint64_t first = nextTxn;
+        std::int64_t now = wallClock();
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            LedgerEntry e = {};
+            e.txnId = nextTxn++;
+            e.timestamp = now;
+            e.amountPaise = records[i].amount.toPaise();
+            e.reference = records[i].reference;
+            e.channel = static_cast<std::uint8_t>(records[i].channel);
+            pending.push_back(e);
+        }
+        std::uint64_t myBatch = openBatch;
+
+        while(durableBatch < myBatch && !failed)
+        {
+            if(flushing)
+            {
+                synced.wait(lock);
+                continue;
+            }
+            // become the leader for everything queued so far
+            flushing = true;
+            std::uint64_t batch = openBatch++;
+            writing.swap(pending);
+            lock.unlock();
+            bool ok = writeAll(fd, writing.data(), writing.size() * sizeof(LedgerEntry)) && syncFile(fd);
+            lock.lock();
+            writing.clear();
+            flushing = false;
+            ++syncs;
+            if(ok)
+            {
+                durableBatch = batch;
+            }
+            else
+            {
+                failed = true;
+            }
+            synced.notify_all();
+        }
+        return failed ? 0 : first;
+    }
+
+    std::uint64_t append(PaymentChannel channel, Money amount, std::uint64_t reference)
+    {
+        PaymentRecord record = {channel, amount, {}, 0, reference};
+        return append(&record, 1);
+    }
+
+    std::size_t syncCount()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return syncs;
+    }
+};
+
+// Maps a ledger file and scans it for totals.
+class LedgerReader
+{
+    MappedFile file;
+    const LedgerEntry* entries = nullptr;
+    std::size_t count = 0;
+public :
+    bool open(const std::string& path)
+    {
+        if(!file.open(path) || file.size() < sizeof(LedgerHeader))
+        {
+            return false;
+        }
+        const LedgerHeader* header = reinterpret_cast<const LedgerHeader*>(file.data());
+        if(!std::equal(ledgerMagic, ledgerMagic + 8, header->magic) || header->version != ledgerVersion ||
+           header->recordSize != sizeof(LedgerEntry))
+        {
+            return false;
+        }
+        entries = reinterpret_cast<const LedgerEntry*>(file.data() + sizeof(LedgerHeader));
+        count = (file.size() - sizeof(LedgerHeader)) / sizeof(LedgerEntry);
+        return true;
+    }
+
+    const LedgerEntry* data() const { return entries; }
+    std::size_t size() const { return count; }
+
+    // Per-channel totals; entries with an unknown channel are counted in `unknown`.
+    void totals(SettlementSummary (&channels)[channelCount], std::size_t& unknown) const
+    {
+        unknown = 0;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            std::size_t c = entries[i].channel;
+            if(c >= channelCount)
+            {
+                ++unknown;
+                continue;
+            }
+            ++channels[c].count;
+            channels[c].total += Money::fromPaise(entries[i].amountPaise);
+        }
+    }
+};
 
 // STEP1 : Strategy Interface
 class PaymentStrategy
 {
 public :
-    virtual void pay(double amount) = 0;
+    virtual void pay(Money amount) = 0;
+    virtual PaymentChannel channel() const = 0;
+    virtual std::string_view account() const = 0;
     virtual ~PaymentStrategy() = default;
+
+    // Round trip through a gateway, used by the asynchronous checkout.
+    virtual PaymentStatus authorize(PaymentGateway& gateway, Money amount, std::uint64_t reference)
+    {
+        return gateway.charge(channel(), account(), amount, reference);
+    }
+
+    // Settles a group of records of this strategy's channel with one call.
+    virtual SettlementSummary payBatch(const PaymentRecord* records, std::size_t count)
+    {
+        SettlementSummary summary;
+        std::int64_t paise = 0;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            paise += records[i].amount.toPaise();
+        }
+        summary.total = Money::fromPaise(paise);
+        summary.count = count;
+        return summary;
+    }
+};
+
+// STEP2 : Concrete Strategy
+class CreditCardPayment : public PaymentStrategy 
+{
+    std::string cardNumber;
+public :
+    CreditCardPayment(std::string cardNo = "") : cardNumber(cardNo) {}
+
+    PaymentChannel channel() const override { return PaymentChannel::CreditCard; }
+    std::string_view account() const override { return cardNumber; }
+
+    void pay(Money amount) override 
+    {
+        std::cout<<"CreditCardPayment cardNumber : "<<cardNumber << " amount : "<<amount<<" Rupees"<<std::endl;
+    }
+};
+
+class PaypalPayment : public PaymentStrategy 
+{
+    std::string email;
+public :
+    PaypalPayment(std::string email_ = "") : email(email_){}
+
+    PaymentChannel channel() const override { return PaymentChannel::Paypal; }
+    std::string_view account() const override { return email; }
+
+    void pay(Money amount) override 
+    {
+        std::cout<<"PaypalPayment email : "<<email<<" amount : "<<amount<<" Rupees"<<std::endl;
+    }
+};
+
+class UpiPayment : public PaymentStrategy
+{
+    std::string upiId;
+public :
+    UpiPayment(std::string upiId_ = "") : upiId(upiId_) {}
+
+    PaymentChannel channel() const override { return PaymentChannel::Upi; }
+    std::string_view account() const override { return upiId; }
+
+    void pay(Money amount) override 
+    {
+        std::cout<<"UpiPayment upiId : "<<upiId<<" amound : "<<amount<<" Rupees"<<std::endl;
+    }
+};
+
+// STEP 3 : Context 
+class ShoppingCart
+{
+    // shared so that payments still in flight keep their strategy alive
+    std::shared_ptr<PaymentStrategy> paymentStrategy;
+    IdempotencyCache* idempotency = nullptr;
+    PaymentLedger* ledger = nullptr;
+public :
+    void setPaymentStrategy(std::unique_ptr<PaymentStrategy> ps)
+    {
+        paymentStrategy = std::move(ps);
+    }
+
+    // Every checkout that carries a key is checked against this cache first.
+    void setIdempotencyCache(IdempotencyCache* cache)
+    {
+        idempotency = cache;
+    }
+
+    // Every completed payment is appended to this ledger before checkout returns.
+    void setLedger(PaymentLedger* l)
+    {
+        ledger = l;
+    }
+
+    // Once pay() has run the key stays claimed, even if the ledger write fails :
+    // the customer was charged, so a retry must not charge again. The failure
+    // is reported for reconciliation instead.
+    void checkout(Money amount, std::string_view idempotencyKey = {})
+    {
+        if(!paymentStrategy)
+        {
+            std::cout<<"paymentStrategy not selected"<<std::endl;
+            return;
+        }
+        if(!validation::accountValid(paymentStrategy->channel(), paymentStrategy->account()))
+        {
+            std::cout<<"invalid "<<channelName(paymentStrategy->channel())<<" account "<<paymentStrategy->account()
+                     <<", payment rejected"<<std::endl;
+            return;
+        }
+        std::uint64_t key = idempotencyKey.empty() ? 0 : IdempotencyCache::keyOf(idempotencyKey);
+        if(idempotency && key && !idempotency->tryClaim(key))
+        {
+            std::cout<<"duplicate request "<<idempotencyKey<<" ignored"<<std::endl;
+            return;
+        }
+        std::uint64_t reference = merchantReference(key);
+        paymentStrategy->pay(amount);
+        if(ledger)
+        {
+            std::uint64_t txn = ledger->append(paymentStrategy->channel(), amount, reference);
+            if(txn)
+            {
+                std::cout<<"ledger txn #"<<txn<<std::endl;
+            }
+            else
+            {
+                std::cout<<"ledger write failed : payment ref "<<reference<<" charged but not recorded"<<std::endl;
+            }
+        }
+    }
+
+    // Runs the gateway round trip on the pool. submit() blocks while the pool's
+    // queue is full, which is the backpressure on callers. The gateway must
+    // outlive every payment started here.
+    std::future<PaymentStatus> checkoutAsync(WorkerPool& pool, PaymentGateway& gateway, Money amount,
+                                             std::string_view idempotencyKey = {})
+    {
+        auto promise = std::make_shared<std::promise<PaymentStatus>>();
+        std::future<PaymentStatus> result = promise->get_future();
+        checkoutAsync(pool, gateway, amount, [promise](PaymentStatus status)
+        {
+            promise->set_value(status);
+        }, idempotencyKey);
+        return result;
+    }
+
+    // A declined payment releases its key so the client can retry it. An
+    // approved one whose ledger write fails completes as Unrecorded and keeps
+    // its key, since the customer has been charged.
+    void checkoutAsync(WorkerPool& pool, PaymentGateway& gateway, Money amount, std::function<void(PaymentStatus)> onComplete,
+                       std::string_view idempotencyKey = {})
+    {
+        std::shared_ptr<PaymentStrategy> strategy = paymentStrategy;
+        if(!strategy)
+        {
+            onComplete(PaymentStatus::Declined);
+            return;
+        }
+        if(!validation::accountValid(strategy->channel(), strategy->account()))
+        {
+            onComplete(PaymentStatus::Rejected);
+            return;
+        }
+        std::uint64_t key = idempotencyKey.empty() ? 0 : IdempotencyCache::keyOf(idempotencyKey);
+        if(idempotency && key && !idempotency->tryClaim(key))
+        {
+            onComplete(PaymentStatus::Duplicate);
+            return;
+        }
+        IdempotencyCache* cache = idempotency;
+        PaymentLedger* log = ledger;
+        std::uint64_t reference = merchantReference(key);
+        pool.submit([strategy, &gateway, amount, key, reference, cache, log, onComplete = std::move(onComplete)]
+        {
+            PaymentStatus status = strategy->authorize(gateway, amount, reference);
+            if(status == PaymentStatus::Declined && key && cache)
+            {
+                cache->release(key);
+            }
+            if(status == PaymentStatus::Approved && log && !log->append(strategy->channel(), amount, reference))
+            {
+                status = PaymentStatus::Unrecorded;
+            }
+            onComplete(status);
+        });
+    }
+
+    // Batch settlement : one strategy per channel handles every record of that channel.
+    void setChannelStrategy(std::unique_ptr<PaymentStrategy> ps)
+    {
+        std::size_t c = static_cast<std::size_t>(ps->channel());
+        channelStrategies[c] = std::move(ps);
+    }
+
+    struct BatchReport
+    {
+        SettlementSummary channels[channelCount];
+        std::size_t unrouted = 0;    // records whose channel has no strategy
+        std::size_t duplicates = 0;  // records whose idempotency key was already used
+        std::size_t rejected = 0;    // records that failed validation
+        std::size_t unrecorded = 0;  // records charged whose ledger write failed; their keys stay claimed
+    };
+
+    // Records are validated and deduplicated in parallel, grouped by channel
+    // with a counting pass, and each group is cut into chunks; every chunk is
+    // one payBatch call on a worker thread.
+    BatchReport checkoutBatch(WorkerPool& pool, const PaymentRecord* records, std::size_t count)
+    {
+        BatchReport report;
+        screen(pool, records, count);
+
+        std::size_t offsets[channelCount + 1] = {};
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(verdicts[i] != Accepted)
+            {
+                ++(verdicts[i] == Invalid ? report.rejected : report.duplicates);
+                continue;
+            }
+            ++offsets[static_cast<std::size_t>(records[i].channel) + 1];
+        }
+        for(std::size_t c = 0; c < channelCount; ++c)
+        {
+            offsets[c + 1] += offsets[c];
+        }
+        grouped.resize(offsets[channelCount]);
+        std::size_t next[channelCount];
+        std::copy(offsets, offsets + channelCount, next);
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(verdicts[i] == Accepted)
+            {
+                PaymentRecord& record = grouped[next[static_cast<std::size_t>(records[i].channel)]++];
+                record = records[i];
+                record.reference = record.reference ? record.reference : merchantReference(record.idempotencyKey);
+            }
+        }
+
+        struct Chunk
+        {
+            std::size_t channel, begin, end;
+            SettlementSummary result;
+            std::size_t unrecorded;
+        };
+        std::vector<Chunk> chunks;
+        for(std::size_t c = 0; c < channelCount; ++c)
+        {
+            if(!channelStrategies[c])
+            {
+                report.unrouted += offsets[c + 1] - offsets[c];
+                releaseKeys(offsets[c], offsets[c + 1]);
+                continue;
+            }
+            for(std::size_t b = offsets[c]; b < offsets[c + 1]; b += batchChunk)
+            {
+                chunks.push_back({c, b, std::min(offsets[c + 1], b + batchChunk), {}, 0});
+            }
+        }
+
+        TaskGroup group;
+        group.add(chunks.size());
+        for(Chunk& chunk : chunks)
+        {
+            pool.submit([this, &chunk, &group]
+            {
+                chunk.result = channelStrategies[chunk.channel]->payBatch(grouped.data() + chunk.begin, chunk.end - chunk.begin);
+                if(ledger && !ledger->append(grouped.data() + chunk.begin, chunk.end - chunk.begin))
+                {
+                    chunk.unrecorded = chunk.end - chunk.begin;
+                }
+                group.done();
+            });
+        }
+        group.wait();
+
+        for(const Chunk& chunk : chunks)
+        {
+            report.channels[chunk.channel] += chunk.result;
+            report.unrecorded += chunk.unrecorded;
+        }
+        return report;
+    }
+
+private :
+    enum Verdict : std::uint8_t { Invalid = 0, Accepted = 1, Duplicate = 2 };
+
+    // Validates every record and claims the keys of the valid ones, in parallel chunks.
+    void screen(WorkerPool& pool, const PaymentRecord* records, std::size_t count)
+    {
+        verdicts.resize(count);
+        TaskGroup group;
+        for(std::size_t b = 0; b < count; b += batchChunk)
+        {
+            std::size_t e = std::min(count, b + batchChunk);
+            group.add();
+            pool.submit([this, records, b, e, &group]
+            {
+                validation::validateBatch(records + b, e - b, verdicts.data() + b);
+                if(idempotency)
+                {
+                    for(std::size_t i = b; i < e; ++i)
+                    {
+                        if(verdicts[i] == Accepted && records[i].idempotencyKey && !idempotency->tryClaim(records[i].idempotencyKey))
+                        {
+                            verdicts[i] = Duplicate;
+                        }
+                    }
+                }
+                group.done();
+            });
+        }
+        group.wait();
+    }
+
+    // Gives back the keys claimed by screen() for grouped records that were never charged.
+    void releaseKeys(std::size_t begin, std::size_t end)
+    {
+        for(std::size_t i = begin; idempotency && i < end; ++i)
+        {
+            if(grouped[i].idempotencyKey)
+            {
+                idempotency->release(grouped[i].idempotencyKey);
+            }
+        }
+    }
+
+    static constexpr std::size_t batchChunk = 4096;
+    std::unique_ptr<PaymentStrategy> channelStrategies[channelCount];
+    std::vector<PaymentRecord> grouped;
+    std::vector<std::uint8_t> verdicts;
+};
+
+// Reconciliation : ledger entries and gateway settlement rows are both reduced
+// to ReconRow, spread over partition files by merchant reference, and each
+// partition is joined on its own so memory stays bounded by the largest partition.
+struct ReconRow
+{
+    std::uint64_t reference;
+    std::int64_t amountPaise;
+    std::uint8_t channel;
+    std::uint8_t reserved[7];
 };
 
-// STEP2 : Concrete Strategy
-class CreditCardPayment : public PaymentStrategy 
+inline bool channelFromName(std::string_view name, PaymentChannel& channel)
 {
-    std::string cardNumber;
+    for(std::size_t c = 0; c < channelCount; ++c)
+    {
+        if(name == channelName(static_cast<PaymentChannel>(c)))
+        {
+            channel = static_cast<PaymentChannel>(c);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Directory of its own for one run's temp files, so concurrent runs never
+// share a path. Removed with everything in it on destruction.
+class TempDirectory
+{
+    std::filesystem::path dir;
 public :
-    CreditCardPayment(std::string cardNo) : cardNumber(cardNo) {}
+    TempDirectory() = default;
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator=(const TempDirectory&) = delete;
+    ~TempDirectory()
+    {
+        std::error_code ec;
+        if(!dir.empty())
+        {
+            std::filesystem::remove_all(dir, ec);
+        }
+    }
 
-    void pay(double amount) override 
+    // create_directory fails on an existing name, so the directory that is
+    // created belongs to this run alone
+    bool create(const std::filesystem::path& parent, const std::string& stem)
     {
-        std::cout<<"CreditCardPayment cardNumber : "<<cardNumber << " amount : "<<amount<<" Rupees"<<std::endl;
+        static std::atomic<std::uint64_t> next{static_cast<std::uint64_t>(std::chrono::system_clock::now().time_since_epoch().count())};
+        for(int attempt = 0; attempt < 100; ++attempt)
+        {
+            std::error_code ec;
+            std::filesystem::path candidate = parent / (stem + std::to_string(next++));
+            if(std::filesystem::create_directory(candidate, ec))
+            {
+                dir = candidate;
+                return true;
+            }
+            if(ec)
+            {
+                return false;
+            }
+        }
+        return false;
     }
+
+    std::string file(const std::string& name) const { return (dir / name).string(); }
 };
 
-class PaypalPayment : public PaymentStrategy 
+// One temp file per partition, shared by every parser thread. Up to maxOpenParts
+// files stay open from create() to remove(); past that each append or read opens
+// its file for the duration of the call, so descriptors stay bounded however
+// many partitions a small budget needs.
+class PartitionFiles
 {
-    std::string email;
+    struct Part
+    {
+        std::mutex mtx;
+        std::string path;
+        FILE* file = nullptr;
+    };
+    std::vector<std::unique_ptr<Part>> parts;
+    std::atomic<bool> failed{false};
+
+    static constexpr std::size_t maxOpenParts = 128;
+
 public :
-    PaypalPayment(std::string email_) : email(email_){}
+    PartitionFiles() = default;
+    PartitionFiles(const PartitionFiles&) = delete;
+    PartitionFiles& operator=(const PartitionFiles&) = delete;
+    ~PartitionFiles() { remove(); }
 
-    void pay(double amount) override 
+    bool create(const std::string& prefix, std::size_t count)
     {
-        std::cout<<"PaypalPayment email : "<<email<<" amount : "<<amount<<" Rupees"<<std::endl;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            parts.push_back(std::make_unique<Part>());
+            Part& part = *parts.back();
+            part.path = prefix + std::to_string(i);
+            FILE* f = std::fopen(part.path.c_str(), count <= maxOpenParts ? "w+b" : "wb");
+            if(!f)
+            {
+                return false;
+            }
+            if(count <= maxOpenParts)
+            {
+                part.file = f;
+            }
+            else
+            {
+                std::fclose(f);
+            }
+        }
+        return true;
+    }
+
+    std::size_t size() const { return parts.size(); }
+
+    // false once any append failed; the partitions are incomplete then
+    bool ok() const { return !failed; }
+
+    std::size_t partitionOf(std::uint64_t reference) const
+    {
+        return static_cast<std::size_t>((reference * 0x9E3779B97F4A7C15ULL) >> 32) % parts.size();
+    }
+
+    void append(std::size_t part, const ReconRow* rows, std::size_t n)
+    {
+        Part& p = *parts[part];
+        std::lock_guard<std::mutex> lock(p.mtx);
+        FILE* f = p.file ? p.file : std::fopen(p.path.c_str(), "ab");
+        if(!f)
+        {
+            failed = true;
+            return;
+        }
+        if(std::fwrite(rows, sizeof(ReconRow), n, f) != n)
+        {
+            failed = true;
+        }
+        if(!p.file && std::fclose(f) != 0)
+        {
+            failed = true;
+        }
+    }
+
+    // Reads a whole partition back; only called once all appends are done.
+    bool load(std::size_t part, std::vector<ReconRow>& rows)
+    {
+        FILE* f = openForRead(part);
+        if(!f)
+        {
+            return false;
+        }
+        std::fseek(f, 0, SEEK_END);
+        rows.resize(static_cast<std::size_t>(std::ftell(f)) / sizeof(ReconRow));
+        std::fseek(f, 0, SEEK_SET);
+        bool whole = std::fread(rows.data(), sizeof(ReconRow), rows.size(), f) == rows.size();
+        doneReading(part, f);
+        return whole;
+    }
+
+    // Streams a partition through `block`, calling visit once per filled block.
+    template <typename Visit>
+    bool scan(std::size_t part, std::vector<ReconRow>& block, Visit visit)
+    {
+        FILE* f = openForRead(part);
+        if(!f)
+        {
+            return false;
+        }
+        std::size_t n;
+        while((n = std::fread(block.data(), sizeof(ReconRow), block.size(), f)) > 0)
+        {
+            visit(block.data(), n);
+        }
+        bool whole = !std::ferror(f);
+        doneReading(part, f);
+        return whole;
+    }
+
+    void remove()
+    {
+        for(std::unique_ptr<Part>& p : parts)
+        {
+            if(p->file)
+            {
+                std::fclose(p->file);
+            }
+            std::remove(p->path.c_str());
+        }
+        parts.clear();
+    }
+
+private :
+    // A kept-open file is rewound; the seek also flushes what append wrote.
+    FILE* openForRead(std::size_t part)
+    {
+        Part& p = *parts[part];
+        if(p.file)
+        {
+            return std::fseek(p.file, 0, SEEK_SET) == 0 ? p.file : nullptr;
+        }
+        return std::fopen(p.path.c_str(), "rb");
+    }
+
+    void doneReading(std::size_t part, FILE* f)
+    {
+        if(!parts[part]->file)
+        {
+            std::fclose(f);
+        }
     }
 };
 
-class UpiPayment : public PaymentStrategy
+// Per-thread staging in front of PartitionFiles, so the shared files are locked once per block.
+class PartitionBuffer
 {
-    std::string upiId;
+    PartitionFiles& files;
+    std::size_t blockRows;
+    std::vector<std::vector<ReconRow>> blocks;
 public :
-    UpiPayment(std::string upiId_) : upiId(upiId_) {}
+    PartitionBuffer(PartitionFiles& f, std::size_t rowsPerBlock) : files(f), blockRows(rowsPerBlock), blocks(f.size()) {}
+    ~PartitionBuffer() { flush(); }
 
-    void pay(double amount) override 
+    void push(const ReconRow& row)
     {
-        std::cout<<"UpiPayment upiId : "<<upiId<<" amound : "<<amount<<" Rupees"<<std::endl;
+        std::size_t p = files.partitionOf(row.reference);
+        blocks[p].push_back(row);
+        if(blocks[p].size() == blockRows)
+        {
+            files.append(p, blocks[p].data(), blocks[p].size());
+            blocks[p].clear();
+        }
+    }
+
+    void flush()
+    {
+        for(std::size_t p = 0; p < blocks.size(); ++p)
+        {
+            if(!blocks[p].empty())
+            {
+                files.append(p, blocks[p].data(), blocks[p].size());
+                blocks[p].clear();
+            }
+        }
     }
 };
 
-// STEP 3 : Context 
-class ShoppingCart
+class Reconciler
 {
-    std::unique_ptr<PaymentStrategy> paymentStrategy;
 public :
-    void setPaymentStrategy(std::unique_ptr<PaymentStrategy> ps)
+    enum Outcome { Matched, AmountMismatch, ChannelMismatch, MissingInLedger, MissingInSettlement, DuplicateSettlement, DuplicateLedger, OutcomeCount };
+
+    static const char* outcomeName(Outcome o)
     {
-        paymentStrategy = std::move(ps);
+        static const char* names[OutcomeCount] = {"matched", "amount mismatch", "channel mismatch", "missing in ledger",
+                                                  "missing in settlement", "duplicate settlement", "duplicate in ledger"};
+        return names[o];
     }
 
-    void checkout(double amount)
+    struct Mismatch
+    {
+        Outcome outcome;
+        std::uint64_t reference;
+        std::int64_t ledgerPaise, settledPaise;
+    };
+
+    struct Report
     {
-        if(paymentStrategy)
+        std::size_t counts[channelCount][OutcomeCount] = {};
+        std::size_t ledgerRows = 0, settlementRows = 0, malformedRows = 0;
+        std::vector<Mismatch> samples;  // first few mismatches, for the operator
+    };
+
+    Reconciler(WorkerPool& p, std::size_t memoryBudgetBytes = std::size_t(256) << 20) : pool(p), memoryBudget(memoryBudgetBytes) {}
+
+    bool run(const std::string& ledgerPath, const std::string& settlementPath, Report& report)
+    {
+        LedgerReader ledger;
+        MappedFile settlement;
+        if(!ledger.open(ledgerPath) || !settlement.open(settlementPath))
         {
-            paymentStrategy->pay(amount);
+            return false;
         }
-        else
+
+        // The build side of one partition plus its hash table must fit each thread's
+        // share of the budget; the probe side is streamed. Settlement rows are
+        // counted pessimistically from the file size so that a settlement file
+        // far larger than the ledger still spreads over enough partitions.
+        std::size_t perPartition = std::max<std::size_t>(1, memoryBudget / pool.size() / joinRowBytes);
+        std::size_t rows = std::max(ledger.size(), settlement.size() / minSettlementLine);
+        std::size_t partitions = std::max<std::size_t>(pool.size(), rows / perPartition + 1);
+        // every parser thread stages one block per partition
+        std::size_t blockRows = std::clamp<std::size_t>(memoryBudget / pool.size() / partitions / sizeof(ReconRow), 16, 512);
+        // next to the settlement file, which is where there is room for a copy of it
+        TempDirectory temp;
+        std::filesystem::path settlementDir = std::filesystem::path(settlementPath).parent_path();
+        if(!temp.create(settlementDir.empty() ? "." : settlementDir, ".recon-"))
         {
-            std::cout<<"paymentStrategy not selected"<<std::endl;
+            std::cout<<"could not create a temp directory next to "<<settlementPath<<std::endl;
+            return false;
+        }
+        PartitionFiles ledgerParts, settlementParts;
+        if(!ledgerParts.create(temp.file("L"), partitions) || !settlementParts.create(temp.file("S"), partitions))
+        {
+            return false;
+        }
+
+        report.ledgerRows = ledger.size();
+        partitionLedger(ledger, ledgerParts, blockRows);
+        report.malformedRows = partitionSettlement(settlement, settlementParts, blockRows, report.settlementRows);
+        if(!ledgerParts.ok() || !settlementParts.ok())
+        {
+            return false;
+        }
+
+        std::vector<Report> partial(partitions);
+        std::atomic<bool> joined{true};
+        TaskGroup group;
+        group.add(partitions);
+        for(std::size_t p = 0; p < partitions; ++p)
+        {
+            pool.submit([&, p]
+            {
+                if(!joinPartition(ledgerParts, settlementParts, p, partial[p]))
+                {
+                    joined = false;
+                }
+                group.done();
+            });
+        }
+        group.wait();
+        if(!joined)
+        {
+            return false;
+        }
+
+        for(const Report& r : partial)
+        {
+            for(std::size_t c = 0; c < channelCount; ++c)
+            {
+                for(std::size_t o = 0; o < OutcomeCount; ++o)
+                {
+                    report.counts[c][o] += r.counts[c][o];
+                }
+            }
+            for(const Mismatch& m : r.samples)
+            {
+                if(report.samples.size() < maxSamples)
+                {
+                    report.samples.push_back(m);
+                }
+            }
+        }
+        return true;
+    }
+
+private :
+    static constexpr std::size_t maxSamples = 10;
+    static constexpr std::size_t scanChunk = 1 << 16;
+    static constexpr std::size_t probeRows = 4096;
+    static constexpr std::size_t minSettlementLine = 8;  // "1,Upi,1\n"
+    // a build row, its worst case share of the hash table and its settled flag
+    static constexpr std::size_t joinRowBytes = sizeof(ReconRow) + 4 * sizeof(std::uint32_t) + 1;
+    WorkerPool& pool;
+    std::size_t memoryBudget;
+
+    void partitionLedger(const LedgerReader& ledger, PartitionFiles& parts, std::size_t blockRows)
+    {
+        TaskGroup group;
+        for(std::size_t b = 0; b < ledger.size(); b += scanChunk)
+        {
+            std::size_t e = std::min(ledger.size(), b + scanChunk);
+            group.add();
+            pool.submit([&ledger, &parts, &group, blockRows, b, e]
+            {
+                PartitionBuffer out(parts, blockRows);
+                for(std::size_t i = b; i < e; ++i)
+                {
+                    const LedgerEntry& entry = ledger.data()[i];
+                    ReconRow row = {};
+                    row.reference = entry.reference;
+                    row.amountPaise = entry.amountPaise;
+                    row.channel = entry.channel;
+                    out.push(row);
+                }
+                out.flush();
+                group.done();
+            });
+        }
+        group.wait();
+    }
+
+    // "123.45" -> 12345 paise; false on anything else
+    static bool parseAmount(const char* p, const char* end, std::int64_t& paise)
+    {
+        std::int64_t whole = 0;
+        int fracDigits = 0;
+        std::int64_t frac = 0;
+        bool any = false;
+        bool negative = p < end && *p == '-';
+        p += negative;
+        for(; p < end && *p >= '0' && *p <= '9'; ++p, any = true)
+        {
+            whole = whole * 10 + (*p - '0');
+        }
+        if(p < end && *p == '.')
+        {
+            for(++p; p < end && *p >= '0' && *p <= '9' && fracDigits < 2; ++p, ++fracDigits)
+            {
+                frac = frac * 10 + (*p - '0');
+            }
+        }
+        if(p != end || !any)
+        {
+            return false;
+        }
+        frac *= fracDigits == 1 ? 10 : 1;
+        paise = (whole * 100 + frac) * (negative ? -1 : 1);
+        return true;
+    }
+
+    // One line "reference,channel,amount"; a header line simply fails to parse.
+    static bool parseLine(const char* p, const char* end, ReconRow& row)
+    {
+        if(p < end && end[-1] == '\r')
+        {
+            --end;
+        }
+        const char* comma1 = std::find(p, end, ',');
+        const char* comma2 = std::find(comma1 == end ? end : comma1 + 1, end, ',');
+        if(comma1 == p || comma2 == end)
+        {
+            return false;
+        }
+        std::uint64_t id = 0;
+        for(const char* q = p; q < comma1; ++q)
+        {
+            std::uint64_t digit = static_cast<std::uint64_t>(*q - '0');
+            if(*q < '0' || *q > '9' || id > (~std::uint64_t(0) - digit) / 10)
+            {
+                return false;
+            }
+            id = id * 10 + digit;
+        }
+        PaymentChannel channel;
+        if(!channelFromName(std::string_view(comma1 + 1, static_cast<std::size_t>(comma2 - comma1 - 1)), channel))
+        {
+            return false;
+        }
+        row = {};
+        row.reference = id;
+        row.channel = static_cast<std::uint8_t>(channel);
+        return parseAmount(comma2 + 1, end, row.amountPaise);
+    }
+
+    // Splits the file into byte ranges; each task owns the lines that start inside its range.
+    std::size_t partitionSettlement(const MappedFile& file, PartitionFiles& parts, std::size_t blockRows, std::size_t& rows)
+    {
+        const char* data = reinterpret_cast<const char*>(file.data());
+        std::size_t size = file.size();
+        std::size_t rangeBytes = std::size_t(4) << 20;
+        std::atomic<std::size_t> parsed{0}, malformed{0};
+        TaskGroup group;
+        for(std::size_t b = 0; b < size; b += rangeBytes)
+        {
+            std::size_t e = std::min(size, b + rangeBytes);
+            group.add();
+            pool.submit([data, size, b, e, blockRows, &parts, &parsed, &malformed, &group]
+            {
+                PartitionBuffer out(parts, blockRows);
+                const char* p = data + b;
+                if(b > 0 && data[b - 1] != '\n')
+                {
+                    p = std::find(p, data + size, '\n');
+                    p += p < data + size;
+                }
+                std::size_t ok = 0, bad = 0;
+                while(p < data + e)
+                {
+                    const char* nl = std::find(p, data + size, '\n');
+                    ReconRow row;
+                    if(parseLine(p, nl, row))
+                    {
+                        out.push(row);
+                        ++ok;
+                    }
+                    else if(nl != p && !(p == data && *p > '9'))
+                    {
+                        ++bad;  // blank lines and the header are not errors
+                    }
+                    p = nl + (nl < data + size);
+                }
+                out.flush();
+                parsed += ok;
+                malformed += bad;
+                group.done();
+            });
+        }
+        group.wait();
+        rows = parsed;
+        return malformed;
+    }
+
+    // Hash join of one partition : build on the ledger rows, probe with the settlement rows block by block.
+    static bool joinPartition(PartitionFiles& ledgerParts, PartitionFiles& settlementParts, std::size_t part, Report& report)
+    {
+        std::vector<ReconRow> ledgerRows;
+        if(!ledgerParts.load(part, ledgerRows))
+        {
+            return false;
+        }
+
+        std::size_t tableSize = 16;
+        while(tableSize < ledgerRows.size() * 2)
+        {
+            tableSize *= 2;
+        }
+        const std::uint32_t empty = 0xFFFFFFFFu;
+        std::vector<std::uint32_t> table(tableSize, empty);
+        std::vector<std::uint8_t> settled(ledgerRows.size(), 0);
+        auto slotOf = [tableSize](std::uint64_t id)
+        {
+            return static_cast<std::size_t>((id * 0xff51afd7ed558ccdULL) >> 17) & (tableSize - 1);
+        };
+        auto note = [&report](std::size_t channel, Outcome o, std::uint64_t id, std::int64_t ledgerPaise, std::int64_t settledPaise)
+        {
+            ++report.counts[channel < channelCount ? channel : 0][o];
+            if(o != Matched && report.samples.size() < maxSamples)
+            {
+                report.samples.push_back({o, id, ledgerPaise, settledPaise});
+            }
+        };
+
+        // the first entry for a reference is the booking settlement rows are matched
+        // against; later ones are reported as duplicates and take no part in the join
+        for(std::uint32_t i = 0; i < ledgerRows.size(); ++i)
+        {
+            std::size_t s = slotOf(ledgerRows[i].reference);
+            while(table[s] != empty && ledgerRows[table[s]].reference != ledgerRows[i].reference)
+            {
+                s = (s + 1) & (tableSize - 1);
+            }
+            if(table[s] != empty)
+            {
+                settled[i] = 1;
+                note(ledgerRows[i].channel, DuplicateLedger, ledgerRows[i].reference, ledgerRows[i].amountPaise, 0);
+                continue;
+            }
+            table[s] = i;
+        }
+
+        std::vector<ReconRow> block(probeRows);
+        bool scanned = settlementParts.scan(part, block, [&](const ReconRow* rows, std::size_t n)
+        {
+            for(const ReconRow* row = rows; row < rows + n; ++row)
+            {
+                std::size_t s = slotOf(row->reference);
+                while(table[s] != empty && ledgerRows[table[s]].reference != row->reference)
+                {
+                    s = (s + 1) & (tableSize - 1);
+                }
+                if(table[s] == empty)
+                {
+                    note(row->channel, MissingInLedger, row->reference, 0, row->amountPaise);
+                    continue;
+                }
+                std::uint32_t i = table[s];
+                const ReconRow& booked = ledgerRows[i];
+                if(settled[i]++)
+                {
+                    settled[i] = 1;
+                    note(row->channel, DuplicateSettlement, row->reference, booked.amountPaise, row->amountPaise);
+                }
+                else if(booked.amountPaise != row->amountPaise)
+                {
+                    note(booked.channel, AmountMismatch, row->reference, booked.amountPaise, row->amountPaise);
+                }
+                else if(booked.channel != row->channel)
+                {
+                    note(booked.channel, ChannelMismatch, row->reference, booked.amountPaise, row->amountPaise);
+                }
+                else
+                {
+                    note(booked.channel, Matched, row->reference, booked.amountPaise, row->amountPaise);
+                }
+            }
+        });
+        if(!scanned)
+        {
+            return false;
+        }
+        for(std::size_t i = 0; i < ledgerRows.size(); ++i)
+        {
+            if(!settled[i])
+            {
+                note(ledgerRows[i].channel, MissingInSettlement, ledgerRows[i].reference, ledgerRows[i].amountPaise, 0);
+            }
         }
+        return true;
     }
 };
 
-int main()
+// Settles a generated batch and reports the throughput.
+void runBatchDemo(std::size_t count, unsigned threads, const std::string& ledgerPath)
+{
+    // channel is index % 3; the last three accounts fail validation
+    std::vector<std::string> accounts = {"4111111111111111", "charan481@gmail.com", "9898565432@ybl",
+                                         "5500 0055 5555 5559", "shop@example.com", "store@okaxis",
+                                         "4111111111111112", "not-an-email", "x@"};
+    std::vector<PaymentRecord> records(count);
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        std::size_t a = (i * 7919) % accounts.size();
+        // every 100th record is a client retry of the one before it
+        std::uint64_t order = (i % 100 == 99) ? i : i + 1;
+        records[i] = {static_cast<PaymentChannel>(a % channelCount), Money::fromPaise(10000 + std::int64_t(i % 90000)), accounts[a], order};
+    }
+
+    ShoppingCart cart;
+    cart.setChannelStrategy(std::make_unique<CreditCardPayment>());
+    cart.setChannelStrategy(std::make_unique<PaypalPayment>());
+    cart.setChannelStrategy(std::make_unique<UpiPayment>());
+    IdempotencyCache idempotency(count, std::chrono::minutes(10));
+    cart.setIdempotencyCache(&idempotency);
+    PaymentLedger ledger;
+    if(!ledgerPath.empty())
+    {
+        if(!ledger.open(ledgerPath))
+        {
+            std::cout<<"cannot open ledger "<<ledgerPath<<std::endl;
+            return;
+        }
+        cart.setLedger(&ledger);
+    }
+
+    WorkerPool pool(threads, threads * 4);
+    auto start = std::chrono::steady_clock::now();
+    ShoppingCart::BatchReport report = cart.checkoutBatch(pool, records.data(), records.size());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(std::size_t c = 0; c < channelCount; ++c)
+    {
+        std::cout<<channelName(static_cast<PaymentChannel>(c))<<" : "<<report.channels[c].count
+                 <<" payments, "<<report.channels[c].total<<" Rupees"<<std::endl;
+    }
+    std::cout<<report.duplicates<<" duplicate retries dropped, "<<report.rejected<<" invalid records rejected"<<std::endl;
+    if(report.unrecorded)
+    {
+        std::cout<<report.unrecorded<<" payments charged but not recorded in the ledger"<<std::endl;
+    }
+    if(!ledgerPath.empty())
+    {
+        std::cout<<"ledger : "<<ledger.syncCount()<<" syncs"<<std::endl;
+    }
+    std::cout<<count<<" payments on "<<threads<<" threads in "<<seconds * 1000<<" ms ("
+             <<count / seconds<<" payments/s)"<<std::endl;
+}
+
+// Pushes payments through a loopback gateway and reports the in-flight peak.
+void runAsyncDemo(std::size_t payments, unsigned workers, std::chrono::microseconds latency, std::size_t queue)
+{
+    ShoppingCart cart;
+    cart.setPaymentStrategy(std::make_unique<UpiPayment>("9898565432@ybl"));
+    LoopbackGateway gateway(latency);
+    WorkerPool pool(workers, queue);
+
+    std::vector<std::future<PaymentStatus>> results;
+    results.reserve(payments);
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < payments; ++i)
+    {
+        results.push_back(cart.checkoutAsync(pool, gateway, Money::fromPaise(10000 + std::int64_t(i % 90000))));
+    }
+    std::size_t approved = 0;
+    for(std::future<PaymentStatus>& r : results)
+    {
+        approved += r.get() == PaymentStatus::Approved;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout<<approved<<"/"<<payments<<" approved, "<<workers<<" workers, gateway latency "
+             <<latency.count() / 1000.0<<" ms"<<std::endl;
+    std::cout<<"peak in flight : "<<gateway.peakInFlight()<<", "<<payments / seconds<<" payments/s"<<std::endl;
+}
+
+// Times repeat lookups, the path every client retry takes.
+void runIdempotencyDemo(std::size_t keys)
+{
+    IdempotencyCache cache(keys, std::chrono::minutes(10));
+    std::vector<std::uint64_t> hashed(keys);
+    for(std::size_t i = 0; i < keys; ++i)
+    {
+        hashed[i] = IdempotencyCache::keyOf("order-" + std::to_string(i));
+        cache.tryClaim(hashed[i]);
+    }
+
+    std::size_t repeats = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < keys; ++i)
+    {
+        repeats += !cache.tryClaim(hashed[(i * 7919) % keys]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout<<repeats<<"/"<<keys<<" repeats caught, "<<seconds * 1e9 / keys<<" ns per lookup"<<std::endl;
+}
+
+// Runs the Money kernels over generated amounts : 10% off, then 18% GST, then the total.
+void runMoneyDemo(std::size_t count)
+{
+    std::vector<Money> prices(count), discounted(count), taxed(count);
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        prices[i] = Money::fromPaise(std::int64_t((i * 2654435761u) % 10000000) + 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    moneykernels::scale(prices.data(), discounted.data(), count, 9000);
+    moneykernels::addTax(discounted.data(), taxed.data(), count, 1800);
+    Money total = moneykernels::sum(taxed.data(), count);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout<<"gross "<<moneykernels::sum(prices.data(), count)<<", after 10% off and 18% GST "<<total<<" Rupees"<<std::endl;
+    std::cout<<count<<" amounts in "<<seconds * 1000<<" ms ("<<count / seconds<<" amounts/s)"<<std::endl;
+}
+
+// Writes a gateway settlement CSV for a ledger with a few planted discrepancies :
+// every 1000th payment unsettled, every 997th off by one paisa, every 5000th settled twice.
+int runMakeSettlement(const std::string& ledgerPath, const std::string& csvPath)
+{
+    LedgerReader reader;
+    if(!reader.open(ledgerPath))
+    {
+        std::cout<<"cannot read ledger "<<ledgerPath<<std::endl;
+        return 1;
+    }
+    FILE* out = std::fopen(csvPath.c_str(), "wb");
+    if(!out)
+    {
+        std::cout<<"cannot write "<<csvPath<<std::endl;
+        return 1;
+    }
+    std::vector<char> buffer(1 << 20);
+    std::setvbuf(out, buffer.data(), _IOFBF, buffer.size());
+    std::fputs("reference,channel,amount\n", out);
+    for(std::size_t i = 0; i < reader.size(); ++i)
+    {
+        const LedgerEntry& e = reader.data()[i];
+        if(e.txnId % 1000 == 0)
+        {
+            continue;
+        }
+        Money amount = Money::fromPaise(e.amountPaise + (e.txnId % 997 == 0 ? 1 : 0));
+        std::string line = std::to_string(e.reference) + "," + channelName(static_cast<PaymentChannel>(e.channel)) + "," + amount.str() + "\n";
+        std::fputs(line.c_str(), out);
+        if(e.txnId % 5000 == 1)
+        {
+            std::fputs(line.c_str(), out);
+        }
+    }
+    std::fclose(out);
+    return 0;
+}
+
+int runReconcile(const std::string& ledgerPath, const std::string& csvPath, unsigned threads)
+{
+    WorkerPool pool(threads, threads * 4);
+    Reconciler reconciler(pool);
+    Reconciler::Report report;
+    auto start = std::chrono::steady_clock::now();
+    if(!reconciler.run(ledgerPath, csvPath, report))
+    {
+        std::cout<<"cannot reconcile "<<ledgerPath<<" against "<<csvPath<<std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(std::size_t c = 0; c < channelCount; ++c)
+    {
+        std::cout<<channelName(static_cast<PaymentChannel>(c))<<" :";
+        for(std::size_t o = 0; o < Reconciler::OutcomeCount; ++o)
+        {
+            std::cout<<" "<<Reconciler::outcomeName(static_cast<Reconciler::Outcome>(o))<<" "<<report.counts[c][o]<<(o + 1 < Reconciler::OutcomeCount ? "," : "");
+        }
+        std::cout<<std::endl;
+    }
+    for(const Reconciler::Mismatch& m : report.samples)
+    {
+        std::cout<<"  ref "<<m.reference<<" : "<<Reconciler::outcomeName(m.outcome)<<" (ledger "<<Money::fromPaise(m.ledgerPaise)
+                 <<", settled "<<Money::fromPaise(m.settledPaise)<<")"<<std::endl;
+    }
+    if(report.malformedRows)
+    {
+        std::cout<<report.malformedRows<<" malformed settlement rows skipped"<<std::endl;
+    }
+    std::cout<<report.ledgerRows<<" ledger entries against "<<report.settlementRows<<" settlement rows in "
+             <<seconds * 1000<<" ms on "<<threads<<" threads"<<std::endl;
+    return 0;
+}
+
+// End-of-day totals straight from the mapped ledger.
+int runLedgerReport(const std::string& path)
+{
+    LedgerReader reader;
+    if(!reader.open(path))
+    {
+        std::cout<<"cannot read ledger "<<path<<std::endl;
+        return 1;
+    }
+    SettlementSummary channels[channelCount];
+    std::size_t unknown = 0;
+    auto start = std::chrono::steady_clock::now();
+    reader.totals(channels, unknown);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(std::size_t c = 0; c < channelCount; ++c)
+    {
+        std::cout<<channelName(static_cast<PaymentChannel>(c))<<" : "<<channels[c].count
+                 <<" payments, "<<channels[c].total<<" Rupees"<<std::endl;
+    }
+    if(unknown)
+    {
+        std::cout<<unknown<<" entries with an unknown channel"<<std::endl;
+    }
+    std::cout<<reader.size()<<" entries scanned in "<<seconds * 1000<<" ms ("
+             <<reader.size() / seconds<<" entries/s)"<<std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
 {
+    // async [payments] [workers] [latencyMs] [queue] : measure sustainable in-flight payments
+    if(argc > 1 && std::string(argv[1]) == "async")
+    {
+        std::size_t payments = argc > 2 ? std::stoull(argv[2]) : 20000;
+        unsigned workers = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 256;
+        double latencyMs = argc > 4 ? std::stod(argv[4]) : 20.0;
+        std::size_t queue = argc > 5 ? std::stoull(argv[5]) : 1024;
+        runAsyncDemo(payments, workers, std::chrono::microseconds(static_cast<long long>(latencyMs * 1000)), queue);
+        return 0;
+    }
+
+    // idempotency [keys] : cost of answering a repeated key
+    if(argc > 1 && std::string(argv[1]) == "idempotency")
+    {
+        runIdempotencyDemo(argc > 2 ? std::stoull(argv[2]) : 1000000);
+        return 0;
+    }
+
+    // batch [count] [threads] [ledger] : settle generated records instead of one interactive payment
+    if(argc > 1 && std::string(argv[1]) == "batch")
+    {
+        std::size_t count = argc > 2 ? std::stoull(argv[2]) : 1000000;
+        unsigned threads = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : std::max(1u, std::thread::hardware_concurrency());
+        runBatchDemo(count, threads, argc > 4 ? argv[4] : "");
+        return 0;
+    }
+
+    // money [count] : discount, tax and total kernels over generated amounts
+    if(argc > 1 && std::string(argv[1]) == "money")
+    {
+        runMoneyDemo(argc > 2 ? std::stoull(argv[2]) : 10000000);
+        return 0;
+    }
+
+    // make-settlement <ledger> <out.csv> : gateway settlement file with planted discrepancies
+    if(argc > 3 && std::string(argv[1]) == "make-settlement")
+    {
+        return runMakeSettlement(argv[2], argv[3]);
+    }
+
+    // reconcile <ledger> <settlement.csv> [threads] : join the ledger against the gateway's settlement
+    if(argc > 3 && std::string(argv[1]) == "reconcile")
+    {
+        unsigned threads = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : std::max(1u, std::thread::hardware_concurrency());
+        return runReconcile(argv[2], argv[3], threads);
+    }
+
+    // ledger-report <ledger> : per-channel totals of a ledger file
+    if(argc > 2 && std::string(argv[1]) == "ledger-report")
+    {
+        return runLedgerReport(argv[2]);
+    }
+
+    // [ledger] : one interactive payment, recorded in the ledger file when one is given
+    std::string ledgerPath = argc > 1 ? argv[1] : "";
+    PaymentLedger ledger;
+    if(!ledgerPath.empty() && !ledger.open(ledgerPath))
+    {
+        std::cout<<"cannot open ledger "<<ledgerPath<<std::endl;
+        return 1;
+    }
+
     ShoppingCart cart;
     int choice ;
     double amount;
@@ -113,6 +2217,14 @@ int main()
             return 0;
     }
 
-    cart.checkout(amount);
+    IdempotencyCache idempotency(1024, std::chrono::minutes(10));
+    cart.setIdempotencyCache(&idempotency);
+    if(!ledgerPath.empty())
+    {
+        cart.setLedger(&ledger);
+    }
+    cart.checkout(Money::fromRupees(amount), "order-1");
+    // a client retry of the same order is not charged again
+    cart.checkout(Money::fromRupees(amount), "order-1");
     return 0;
 }
\ No newline at end of file
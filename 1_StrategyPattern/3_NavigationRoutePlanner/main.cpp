@@ -1,69 +1,3725 @@
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <charconv>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using NodeId = std::uint32_t;
+using ArcId = std::uint32_t;
+
+constexpr NodeId noNode = std::numeric_limits<NodeId>::max();
+constexpr std::uint32_t blocked = std::numeric_limits<std::uint32_t>::max();  // arc not usable in this mode
+constexpr std::uint32_t unreachable = std::numeric_limits<std::uint32_t>::max();
+
+enum class TravelMode : std::uint8_t { Car, Bike, Walk };
+constexpr std::size_t modeCount = 3;
+
+inline const char* costUnit(TravelMode mode)
+{
+    switch(mode)
+    {
+        case TravelMode::Car : return "ms";
+        case TravelMode::Bike : return "m";
+        case TravelMode::Walk : return "scenic cost";
+    }
+    return "";
+}
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+    const unsigned char* ptr = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public :
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+    {
+        take(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if(this != &other)
+        {
+            close();
+            take(other);
+        }
+        return *this;
+    }
+
+    void take(MappedFile& other)
+    {
+        ptr = other.ptr;
+        length = other.length;
+        other.ptr = nullptr;
+        other.length = 0;
+#ifdef _WIN32
+        file = other.file;
+        mapping = other.mapping;
+        other.file = INVALID_HANDLE_VALUE;
+        other.mapping = nullptr;
+#else
+        fd = other.fd;
+        other.fd = -1;
+#endif
+    }
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        length = static_cast<std::size_t>(size.QuadPart);
+        if(length == 0)
+        {
+            return true;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping == nullptr)
+        {
+            return false;
+        }
+        ptr = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return ptr != nullptr;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0)
+        {
+            return false;
+        }
+        length = static_cast<std::size_t>(st.st_size);
+        if(length == 0)
+        {
+            return true;
+        }
+        void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            return false;
+        }
+        ptr = static_cast<const unsigned char*>(p);
+        madvise(p, length, MADV_SEQUENTIAL);
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if(ptr) UnmapViewOfFile(ptr);
+        if(mapping) CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if(ptr) munmap(const_cast<unsigned char*>(ptr), length);
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        ptr = nullptr;
+        length = 0;
+    }
+
+    const unsigned char* data() const { return ptr; }
+    std::size_t size() const { return length; }
+};
+
+// Binary graph file : this header, then each array at a 64-byte aligned offset,
+// so a mapped file is used in place with no parsing.
+struct GraphFileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;       // graphByteOrder as written by the producer
+    std::uint64_t nodeCount;
+    std::uint64_t arcCount;
+    double heuristicFactors[3];
+    std::uint64_t sections[8];     // byte offsets : firstOut, head, length, car, bike, walk, x, y
+    std::uint8_t reserved[40];
+};
+constexpr char graphMagic[8] = {'R', 'O', 'A', 'D', 'G', 'R', 'P', 'H'};
+constexpr std::uint32_t graphVersion = 1;
+constexpr std::uint32_t graphByteOrder = 0x01020304;
+constexpr std::size_t graphAlignment = 64;
+static_assert(sizeof(GraphFileHeader) == 160, "graph header layout is part of the file format");
+
+// Road network in compressed sparse row form : the arcs leaving node v are
+// [firstOut(v), firstOut(v + 1)). Each mode has its own weight per arc.
+//   car  : travel time in ms
+//   bike : distance in meters, motorways blocked
+//   walk : meters stretched by up to 2x on unscenic streets, motorways blocked
+// The arrays are either owned (text input, synthetic grid) or point into a
+// mapped binary file; accessors read through the same pointers either way.
+class RoadGraph
+{
+    std::vector<ArcId> firstOutArcs;
+    std::vector<NodeId> heads;
+    std::vector<std::uint32_t> lengths;  // meters
+    std::vector<std::uint32_t> modeWeights[modeCount];
+    std::vector<float> xs, ys;           // planar coordinates in meters
+    double heuristicFactors[modeCount] = {};
+    MappedFile mapped;
+
+    std::size_t nodes = 0, arcs = 0;
+    const ArcId* firstOutView = nullptr;
+    const NodeId* headView = nullptr;
+    const std::uint32_t* lengthView = nullptr;
+    const std::uint32_t* weightView[modeCount] = {};
+    const float* xView = nullptr;
+    const float* yView = nullptr;
+
+    void bindOwned()
+    {
+        mapped.close();
+        nodes = xs.size();
+        arcs = heads.size();
+        firstOutView = firstOutArcs.data();
+        headView = heads.data();
+        lengthView = lengths.data();
+        for(std::size_t m = 0; m < modeCount; ++m)
+        {
+            weightView[m] = modeWeights[m].data();
+        }
+        xView = xs.data();
+        yView = ys.data();
+    }
+
+    struct InputArc
+    {
+        NodeId from, to;
+        std::uint32_t length;
+        std::uint32_t speedKmh;  // 0 : footpath, no cars
+        std::uint32_t scenic;    // 0..100
+    };
+
+    static constexpr std::uint32_t motorwayKmh = 90;
+    // Input limits that keep every mode's weight well inside 32 bits :
+    // a car crawling along the longest arc takes 3600 * maxArcMeters ms.
+    static constexpr std::uint32_t maxArcMeters = 100000;
+    static constexpr std::uint32_t maxSpeedKmh = 300;
+
+    void build(std::size_t nodes, std::vector<InputArc>& arcs)
+    {
+        firstOutArcs.assign(nodes + 1, 0);
+        for(const InputArc& a : arcs)
+        {
+            ++firstOutArcs[a.from + 1];
+        }
+        for(std::size_t v = 0; v < nodes; ++v)
+        {
+            firstOutArcs[v + 1] += firstOutArcs[v];
+        }
+        heads.resize(arcs.size());
+        lengths.resize(arcs.size());
+        for(std::vector<std::uint32_t>& w : modeWeights)
+        {
+            w.resize(arcs.size());
+        }
+        std::vector<ArcId> next(firstOutArcs.begin(), firstOutArcs.end() - 1);
+        for(const InputArc& a : arcs)
+        {
+            ArcId id = next[a.from]++;
+            heads[id] = a.to;
+            lengths[id] = a.length;
+            modeWeights[static_cast<std::size_t>(TravelMode::Car)][id] =
+                a.speedKmh ? static_cast<std::uint32_t>(std::llround(a.length * 3600.0 / a.speedKmh)) : blocked;
+            bool motorway = a.speedKmh > motorwayKmh;
+            modeWeights[static_cast<std::size_t>(TravelMode::Bike)][id] = motorway ? blocked : a.length;
+            modeWeights[static_cast<std::size_t>(TravelMode::Walk)][id] = motorway ? blocked : a.length * (200 - a.scenic) / 100;
+        }
+        bindOwned();
+        computeHeuristicFactors();
+    }
+
+    // Largest factor f with f * straightLine(u, v) <= weight(u, v) on every arc,
+    // which keeps the A* estimate f * straightLine(v, target) consistent.
+    void computeHeuristicFactors()
+    {
+        for(std::size_t m = 0; m < modeCount; ++m)
+        {
+            double f = std::numeric_limits<double>::max();
+            for(NodeId u = 0; u < nodeCount(); ++u)
+            {
+                for(ArcId a = firstOut(u); a < firstOut(u + 1); ++a)
+                {
+                    double d = straightLine(u, headView[a]);
+                    if(weightView[m][a] != blocked && d > 0.0)
+                    {
+                        f = std::min(f, weightView[m][a] / d);
+                    }
+                }
+            }
+            heuristicFactors[m] = f == std::numeric_limits<double>::max() ? 0.0 : f * 0.999;
+        }
+    }
+
+public :
+    RoadGraph() = default;
+    RoadGraph(const RoadGraph&) = delete;
+    RoadGraph& operator=(const RoadGraph&) = delete;
+
+    // Text format, one record per line, '#' starts a comment :
+    //   v <id> <x> <y>                                     ids 0..n-1, no gaps
+    //   a <from> <to> <lengthMeters> <speedKmh> <scenic>   one directed arc
+    // Lengths up to 100 km, speeds up to 300 km/h and scenic 0..100 are accepted.
+    bool load(const std::string& path)
+    {
+        std::ifstream in(path);
+        if(!in)
+        {
+            return false;
+        }
+        struct InputVertex
+        {
+            std::uint64_t id;
+            float x, y;
+        };
+        std::vector<InputVertex> vertices;
+        std::vector<InputArc> arcs;
+        std::string line;
+        while(std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            char kind = 0;
+            fields>>kind;
+            if(kind == 'v')
+            {
+                InputVertex v;
+                if(!(fields>>v.id>>v.x>>v.y) || v.id >= noNode)
+                {
+                    return false;
+                }
+                vertices.push_back(v);
+            }
+            else if(kind == 'a')
+            {
+                InputArc a;
+                if(!(fields>>a.from>>a.to>>a.length>>a.speedKmh>>a.scenic) ||
+                   a.length > maxArcMeters || a.speedKmh > maxSpeedKmh || a.scenic > 100)
+                {
+                    return false;
+                }
+                arcs.push_back(a);
+            }
+        }
+        // STEP : ids are 0..n-1, so one beyond the number of vertex lines is a gap
+        // or a corrupt id; checked before sizing anything by it
+        xs.assign(vertices.size(), 0.0f);
+        ys.assign(vertices.size(), 0.0f);
+        for(const InputVertex& v : vertices)
+        {
+            if(v.id >= vertices.size())
+            {
+                return false;
+            }
+            xs[v.id] = v.x;
+            ys[v.id] = v.y;
+        }
+        for(const InputArc& a : arcs)
+        {
+            if(a.from >= xs.size() || a.to >= xs.size())
+            {
+                return false;
+            }
+        }
+        build(xs.size(), arcs);
+        return true;
+    }
+
+    // Synthetic city of width x height junctions 100 m apart : a motorway on every
+    // 16th line, arterials on every 4th, footpath diagonals through some blocks.
+    void makeGrid(std::uint32_t width, std::uint32_t height, std::uint32_t seed = 1)
+    {
+        std::uint64_t state = seed;
+        auto random = [&state](std::uint32_t bound)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return static_cast<std::uint32_t>((state >> 33) % bound);
+        };
+        std::size_t nodes = std::size_t(width) * height;
+        xs.resize(nodes);
+        ys.resize(nodes);
+        for(std::uint32_t r = 0; r < height; ++r)
+        {
+            for(std::uint32_t c = 0; c < width; ++c)
+            {
+                xs[r * width + c] = c * 100.0f;
+                ys[r * width + c] = r * 100.0f;
+            }
+        }
+        std::vector<InputArc> arcs;
+        arcs.reserve(nodes * 4);
+        auto road = [&](NodeId u, NodeId v, std::uint32_t line, std::uint32_t length)
+        {
+            std::uint32_t speed = line % 16 == 8 ? 100 : line % 4 == 0 ? 60 : 30;
+            std::uint32_t scenic = random(101);
+            std::uint32_t len = length + random(length / 5 + 1);  // roads are never shorter than the straight line
+            arcs.push_back({u, v, len, speed, scenic});
+            arcs.push_back({v, u, len, speed, scenic});
+        };
+        for(std::uint32_t r = 0; r < height; ++r)
+        {
+            for(std::uint32_t c = 0; c < width; ++c)
+            {
+                NodeId v = r * width + c;
+                if(c + 1 < width)
+                {
+                    road(v, v + 1, r, 100);
+                }
+                if(r + 1 < height)
+                {
+                    road(v, v + width, c, 100);
+                }
+                if(c + 1 < width && r + 1 < height && random(8) == 0)
+                {
+                    std::uint32_t scenic = 60 + random(41);
+                    arcs.push_back({v, v + width + 1, 142, 0, scenic});
+                    arcs.push_back({v + width + 1, v, 142, 0, scenic});
+                }
+            }
+        }
+        build(nodes, arcs);
+    }
+
+    // Grid of identical 100 m streets : between most pairs of nodes many
+    // routes cost exactly the same, the hard case for witness searches.
+    void makeUniformGrid(std::uint32_t width, std::uint32_t height)
+    {
+        std::size_t nodes = std::size_t(width) * height;
+        xs.resize(nodes);
+        ys.resize(nodes);
+        std::vector<InputArc> arcs;
+        arcs.reserve(nodes * 4);
+        for(std::uint32_t r = 0; r < height; ++r)
+        {
+            for(std::uint32_t c = 0; c < width; ++c)
+            {
+                NodeId v = r * width + c;
+                xs[v] = c * 100.0f;
+                ys[v] = r * 100.0f;
+                if(c + 1 < width)
+                {
+                    arcs.push_back({v, v + 1, 100, 30, 50});
+                    arcs.push_back({v + 1, v, 100, 30, 50});
+                }
+                if(r + 1 < height)
+                {
+                    arcs.push_back({v, v + width, 100, 30, 50});
+                    arcs.push_back({v + width, v, 100, 30, 50});
+                }
+            }
+        }
+        build(nodes, arcs);
+    }
+
+    bool save(const std::string& path) const
+    {
+        GraphFileHeader header = {};
+        std::copy(graphMagic, graphMagic + 8, header.magic);
+        header.version = graphVersion;
+        header.byteOrder = graphByteOrder;
+        header.nodeCount = nodes;
+        header.arcCount = arcs;
+        std::copy(heuristicFactors, heuristicFactors + modeCount, header.heuristicFactors);
+        const void* arrays[8] = {firstOutView, headView, lengthView, weightView[0], weightView[1], weightView[2], xView, yView};
+        std::size_t sizes[8] = {(nodes + 1) * sizeof(ArcId), arcs * sizeof(NodeId), arcs * 4, arcs * 4, arcs * 4, arcs * 4,
+                                nodes * sizeof(float), nodes * sizeof(float)};
+        std::uint64_t offset = sizeof(header);
+        for(std::size_t i = 0; i < 8; ++i)
+        {
+            offset = (offset + graphAlignment - 1) / graphAlignment * graphAlignment;
+            header.sections[i] = offset;
+            offset += sizes[i];
+        }
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::uint64_t written = sizeof(header);
+        const char zeros[graphAlignment] = {};
+        for(std::size_t i = 0; i < 8; ++i)
+        {
+            out.write(zeros, static_cast<std::streamsize>(header.sections[i] - written));
+            out.write(static_cast<const char*>(arrays[i]), static_cast<std::streamsize>(sizes[i]));
+            written = header.sections[i] + sizes[i];
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Maps a file written by save() read-only; every process that opens the
+    // same file shares its pages. The whole file is checked before any member
+    // changes, so a rejected file leaves the graph as it was.
+    bool open(const std::string& path)
+    {
+        MappedFile file;
+        if(!file.open(path) || file.size() < sizeof(GraphFileHeader))
+        {
+            return false;
+        }
+        const GraphFileHeader* header = reinterpret_cast<const GraphFileHeader*>(file.data());
+        if(!std::equal(graphMagic, graphMagic + 8, header->magic) || header->version != graphVersion ||
+           header->byteOrder != graphByteOrder)
+        {
+            return false;
+        }
+        // ids must fit their 32-bit types, which also keeps the section sizes below from overflowing
+        if(header->nodeCount >= noNode || header->arcCount > std::numeric_limits<ArcId>::max())
+        {
+            return false;
+        }
+        std::size_t n = static_cast<std::size_t>(header->nodeCount);
+        std::size_t m = static_cast<std::size_t>(header->arcCount);
+        std::size_t sizes[8] = {(n + 1) * sizeof(ArcId), m * sizeof(NodeId), m * 4, m * 4, m * 4, m * 4,
+                                n * sizeof(float), n * sizeof(float)};
+        for(std::size_t i = 0; i < 8; ++i)
+        {
+            if(header->sections[i] % graphAlignment != 0 || header->sections[i] > file.size() ||
+               sizes[i] > file.size() - header->sections[i])
+            {
+                return false;
+            }
+        }
+        for(std::size_t i = 0; i < modeCount; ++i)
+        {
+            if(!std::isfinite(header->heuristicFactors[i]) || header->heuristicFactors[i] < 0.0)
+            {
+                return false;
+            }
+        }
+
+        const unsigned char* base = file.data();
+        const ArcId* firstOut = reinterpret_cast<const ArcId*>(base + header->sections[0]);
+        const NodeId* head = reinterpret_cast<const NodeId*>(base + header->sections[1]);
+        if(firstOut[0] != 0 || firstOut[n] != m)
+        {
+            return false;
+        }
+        for(std::size_t v = 0; v < n; ++v)
+        {
+            if(firstOut[v] > firstOut[v + 1])
+            {
+                return false;
+            }
+        }
+        for(std::size_t a = 0; a < m; ++a)
+        {
+            if(head[a] >= n)
+            {
+                return false;
+            }
+        }
+
+        firstOutArcs = {};
+        heads = {};
+        lengths = {};
+        xs = {};
+        ys = {};
+        for(std::vector<std::uint32_t>& w : modeWeights)
+        {
+            w = {};
+        }
+        mapped = std::move(file);
+        nodes = n;
+        arcs = m;
+        firstOutView = firstOut;
+        headView = head;
+        lengthView = reinterpret_cast<const std::uint32_t*>(base + header->sections[2]);
+        for(std::size_t i = 0; i < modeCount; ++i)
+        {
+            weightView[i] = reinterpret_cast<const std::uint32_t*>(base + header->sections[3 + i]);
+            heuristicFactors[i] = header->heuristicFactors[i];
+        }
+        xView = reinterpret_cast<const float*>(base + header->sections[6]);
+        yView = reinterpret_cast<const float*>(base + header->sections[7]);
+        return true;
+    }
+
+    static bool isBinaryFile(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        char magic[8] = {};
+        in.read(magic, 8);
+        return in && std::equal(graphMagic, graphMagic + 8, magic);
+    }
+
+    std::size_t nodeCount() const { return nodes; }
+    std::size_t arcCount() const { return arcs; }
+    ArcId firstOut(NodeId v) const { return firstOutView[v]; }
+    NodeId head(ArcId a) const { return headView[a]; }
+    std::uint32_t length(ArcId a) const { return lengthView[a]; }
+    const std::uint32_t* weights(TravelMode mode) const { return weightView[static_cast<std::size_t>(mode)]; }
+    double heuristicFactor(TravelMode mode) const { return heuristicFactors[static_cast<std::size_t>(mode)]; }
+    float x(NodeId v) const { return xView[v]; }
+    float y(NodeId v) const { return yView[v]; }
+
+    double straightLine(NodeId u, NodeId v) const
+    {
+        double dx = double(xView[u]) - xView[v];
+        double dy = double(yView[u]) - yView[v];
+        return std::sqrt(dx * dx + dy * dy);
+    }
+};
+
+// Thread pool : a fixed set of workers that execute task indices [0, count).
+// run() blocks until every task finished, the calling thread helps out.
+// Only one run() may be active on a pool at a time.
+class ThreadPool
+{
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(std::size_t)>* job = nullptr;
+    std::size_t nextTask = 0;
+    std::size_t taskCount = 0;
+    std::size_t finished = 0;
+    bool stopping = false;
+
+    void workLoop(std::unique_lock<std::mutex>& lock)
+    {
+        while(nextTask < taskCount)
+        {
+            std::size_t task = nextTask++;
+            const std::function<void(std::size_t)>* fn = job;
+            lock.unlock();
+            (*fn)(task);
+            lock.lock();
+            if(++finished == taskCount)
+            {
+                done.notify_all();
+            }
+        }
+    }
+
+public :
+    explicit ThreadPool(unsigned threads)
+    {
+        for(unsigned i = 1; i < threads; ++i)
+        {
+            workers.emplace_back([this]
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                while(true)
+                {
+                    wake.wait(lock, [this]{ return stopping || nextTask < taskCount; });
+                    if(stopping)
+                    {
+                        return;
+                    }
+                    workLoop(lock);
+                }
+            });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread& t : workers)
+        {
+            t.join();
+        }
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    void run(std::size_t tasks, const std::function<void(std::size_t)>& fn)
+    {
+        if(tasks == 0)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        job = &fn;
+        nextTask = 0;
+        taskCount = tasks;
+        finished = 0;
+        wake.notify_all();
+        workLoop(lock);
+        done.wait(lock, [this]{ return finished == taskCount; });
+    }
+};
+
+inline unsigned defaultThreads()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Monotone priority queue for integer keys : each bucket holds keys that share
+// a prefix with the last popped key, so every element moves at most 32 times.
+class RadixHeap
+{
+    struct Entry
+    {
+        std::uint32_t key;
+        NodeId node;
+    };
+    std::vector<Entry> buckets[33];
+    std::uint32_t last = 0;
+    std::size_t count = 0;
+
+    static std::size_t bucketOf(std::uint32_t key, std::uint32_t last)
+    {
+        std::uint32_t diff = key ^ last;
+        if(diff == 0)
+        {
+            return 0;
+        }
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanReverse(&bit, diff);
+        return bit + 1;
+#else
+        return 32 - static_cast<std::size_t>(__builtin_clz(diff));
+#endif
+    }
+
+public :
+    void clear()
+    {
+        for(std::vector<Entry>& b : buckets)
+        {
+            b.clear();
+        }
+        last = 0;
+        count = 0;
+    }
+
+    bool empty() const { return count == 0; }
+
+    // key must not be below the last popped key
+    void push(std::uint32_t key, NodeId node)
+    {
+        buckets[bucketOf(key, last)].push_back({key, node});
+        ++count;
+    }
+
+    NodeId pop(std::uint32_t& key)
+    {
+        if(buckets[0].empty())
+        {
+            std::size_t i = 1;
+            while(buckets[i].empty())
+            {
+                ++i;
+            }
+            std::uint32_t smallest = buckets[i][0].key;
+            for(const Entry& e : buckets[i])
+            {
+                smallest = std::min(smallest, e.key);
+            }
+            last = smallest;
+            for(const Entry& e : buckets[i])
+            {
+                buckets[bucketOf(e.key, last)].push_back(e);
+            }
+            buckets[i].clear();
+        }
+        Entry e = buckets[0].back();
+        buckets[0].pop_back();
+        --count;
+        key = e.key;
+        return e.node;
+    }
+};
+
+// Dial's bucket queue for small integer keys up to a known bound : one bucket
+// per key, scanned in order, so push and pop are O(1).
+class BucketQueue
+{
+    std::vector<std::vector<NodeId>> buckets;
+    std::size_t current = 0;
+    std::size_t used = 0;   // buckets [0, used) may be non empty
+    std::size_t count = 0;
+
+public :
+    void reset(std::uint32_t maxKey)
+    {
+        for(std::size_t i = 0; i < used; ++i)
+        {
+            buckets[i].clear();
+        }
+        if(buckets.size() <= maxKey)
+        {
+            buckets.resize(std::size_t(maxKey) + 1);
+        }
+        current = 0;
+        used = 0;
+        count = 0;
+    }
+
+    bool empty() const { return count == 0; }
+
+    // key must not be below the last popped key, nor above maxKey
+    void push(std::uint32_t key, NodeId node)
+    {
+        buckets[key].push_back(node);
+        used = std::max<std::size_t>(used, std::size_t(key) + 1);
+        ++count;
+    }
+
+    NodeId pop(std::uint32_t& key)
+    {
+        while(buckets[current].empty())
+        {
+            ++current;
+        }
+        NodeId node = buckets[current].back();
+        buckets[current].pop_back();
+        --count;
+        key = static_cast<std::uint32_t>(current);
+        return node;
+    }
+};
+
+// Per-thread scratch for searches. Node labels are valid only when their
+// stamp equals the current epoch, so starting a new query is O(1).
+class SearchState
+{
+    std::vector<std::uint32_t> distances;
+    std::vector<NodeId> parents;
+    std::vector<std::uint32_t> stamps;
+    std::vector<std::uint32_t> settledStamps;
+    std::uint32_t epoch = 0;
+    std::unique_ptr<SearchState> reverse;
+
+public :
+    RadixHeap heap;
+    BucketQueue buckets;
+
+    SearchState() = default;
+    SearchState(SearchState&&) = default;
+
+    // Second set of labels for bidirectional searches, created on first use.
+    SearchState& backward()
+    {
+        if(!reverse)
+        {
+            reverse = std::make_unique<SearchState>();
+        }
+        return *reverse;
+    }
+
+    void start(std::size_t nodes)
+    {
+        if(stamps.size() < nodes)
+        {
+            distances.resize(nodes);
+            parents.resize(nodes);
+            stamps.assign(nodes, 0);
+            settledStamps.assign(nodes, 0);
+            epoch = 0;
+        }
+        if(++epoch == 0)
+        {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            std::fill(settledStamps.begin(), settledStamps.end(), 0);
+            epoch = 1;
+        }
+        heap.clear();
+    }
+
+    std::uint32_t distance(NodeId v) const { return stamps[v] == epoch ? distances[v] : unreachable; }
+    NodeId parent(NodeId v) const { return parents[v]; }
+
+    void label(NodeId v, std::uint32_t d, NodeId p)
+    {
+        stamps[v] = epoch;
+        distances[v] = d;
+        parents[v] = p;
+    }
+
+    bool settled(NodeId v) const { return settledStamps[v] == epoch; }
+    void settle(NodeId v) { settledStamps[v] = epoch; }
+};
+
+struct Route
+{
+    std::vector<NodeId> path;        // origin .. destination, empty when unreachable
+    std::uint32_t cost = unreachable;
+};
+
+// Dense travel costs, row r for sources[r], column c for targets[c].
+struct DistanceMatrix
+{
+    std::size_t rows = 0, cols = 0;
+    std::vector<std::uint32_t> values;  // row-major, unreachable where there is no path
+
+    void reset(std::size_t r, std::size_t c)
+    {
+        rows = r;
+        cols = c;
+        values.assign(r * c, unreachable);
+    }
+
+    std::uint32_t at(std::size_t r, std::size_t c) const { return values[r * cols + c]; }
+};
+
+// One Dijkstra per source, sources spread over the pool. Each search stops as
+// soon as every target is settled.
+inline void manyToManyDijkstra(const RoadGraph& graph, TravelMode mode, const std::vector<NodeId>& sources,
+                               const std::vector<NodeId>& targets, ThreadPool& pool, DistanceMatrix& matrix)
+{
+    matrix.reset(sources.size(), targets.size());
+    std::vector<std::uint8_t> isTarget(graph.nodeCount(), 0);
+    std::size_t distinctTargets = 0;
+    for(NodeId t : targets)
+    {
+        if(t < graph.nodeCount() && !isTarget[t])
+        {
+            isTarget[t] = 1;
+            ++distinctTargets;
+        }
+    }
+    const std::uint32_t* weight = graph.weights(mode);
+    std::size_t slots = pool.size();
+    pool.run(slots, [&](std::size_t slot)
+    {
+        SearchState state;
+        for(std::size_t r = slot; r < sources.size(); r += slots)
+        {
+            NodeId s = sources[r];
+            if(s >= graph.nodeCount())
+            {
+                continue;
+            }
+            state.start(graph.nodeCount());
+            state.label(s, 0, noNode);
+            state.heap.push(0, s);
+            std::size_t targetsLeft = distinctTargets;
+            while(!state.heap.empty() && targetsLeft > 0)
+            {
+                std::uint32_t key;
+                NodeId u = state.heap.pop(key);
+                if(state.settled(u))
+                {
+                    continue;
+                }
+                state.settle(u);
+                targetsLeft -= isTarget[u];
+                for(ArcId a = graph.firstOut(u); a < graph.firstOut(u + 1); ++a)
+                {
+                    if(weight[a] == blocked)
+                    {
+                        continue;
+                    }
+                    NodeId v = graph.head(a);
+                    std::uint32_t d = key + weight[a];
+                    if(d < state.distance(v))
+                    {
+                        state.label(v, d, u);
+                        state.heap.push(d, v);
+                    }
+                }
+            }
+            std::uint32_t* row = matrix.values.data() + r * matrix.cols;
+            for(std::size_t c = 0; c < targets.size(); ++c)
+            {
+                if(targets[c] < graph.nodeCount() && state.settled(targets[c]))
+                {
+                    row[c] = state.distance(targets[c]);
+                }
+            }
+        }
+    });
+}
+
+// A* over the mode's weights with the straight-line lower bound.
+// Cost of the best route, unreachable if there is none; the parents of the
+// route stay in `state`.
+inline std::uint32_t aStarCost(const RoadGraph& graph, TravelMode mode, NodeId from, NodeId to, SearchState& state)
+{
+    if(from >= graph.nodeCount() || to >= graph.nodeCount())
+    {
+        return unreachable;
+    }
+    const std::uint32_t* weight = graph.weights(mode);
+    double factor = graph.heuristicFactor(mode);
+    auto estimate = [&](NodeId v)
+    {
+        return static_cast<std::uint32_t>(factor * graph.straightLine(v, to));
+    };
+
+    state.start(graph.nodeCount());
+    state.label(from, 0, noNode);
+    state.heap.push(estimate(from), from);
+    while(!state.heap.empty())
+    {
+        std::uint32_t key;
+        NodeId u = state.heap.pop(key);
+        if(state.settled(u))
+        {
+            continue;
+        }
+        state.settle(u);
+        if(u == to)
+        {
+            break;
+        }
+        std::uint32_t du = state.distance(u);
+        for(ArcId a = graph.firstOut(u); a < graph.firstOut(u + 1); ++a)
+        {
+            if(weight[a] == blocked)
+            {
+                continue;
+            }
+            NodeId v = graph.head(a);
+            std::uint32_t dv = du + weight[a];
+            if(dv < state.distance(v))
+            {
+                state.label(v, dv, u);
+                state.heap.push(dv + estimate(v), v);
+            }
+        }
+    }
+
+    return state.settled(to) ? state.distance(to) : unreachable;
+}
+
+inline Route aStar(const RoadGraph& graph, TravelMode mode, NodeId from, NodeId to, SearchState& state)
+{
+    Route route;
+    route.cost = aStarCost(graph, mode, from, to, state);
+    if(route.cost == unreachable)
+    {
+        return route;
+    }
+    for(NodeId v = to; v != noNode; v = state.parent(v))
+    {
+        route.path.push_back(v);
+    }
+    std::reverse(route.path.begin(), route.path.end());
+    return route;
+}
+
+struct Point
+{
+    float x, y;
+};
+
+// Everything reachable from an origin within a distance budget.
+struct Isochrone
+{
+    std::vector<NodeId> nodes;           // in order of distance, origin first
+    std::vector<std::uint32_t> meters;   // distance of nodes[i]
+    std::vector<Point> boundary;         // convex, counter clockwise
+};
+
+// Andrew's monotone chain; sorts `points` in place.
+inline std::vector<Point> convexHull(std::vector<Point>& points)
+{
+    std::sort(points.begin(), points.end(), [](const Point& a, const Point& b)
+    {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+    if(points.size() < 3)
+    {
+        return points;
+    }
+    auto cross = [](const Point& o, const Point& a, const Point& b)
+    {
+        return (double(a.x) - o.x) * (double(b.y) - o.y) - (double(a.y) - o.y) * (double(b.x) - o.x);
+    };
+    std::vector<Point> hull(2 * points.size());
+    std::size_t k = 0;
+    for(std::size_t i = 0; i < points.size(); ++i)
+    {
+        while(k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+        {
+            --k;
+        }
+        hull[k++] = points[i];
+    }
+    for(std::size_t i = points.size() - 1, lower = k + 1; i > 0; --i)
+    {
+        while(k >= lower && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0)
+        {
+            --k;
+        }
+        hull[k++] = points[i - 1];
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+
+// One-to-all search over arc lengths, restricted to arcs open in `mode`,
+// that stops at `budget` meters. Lengths are whole meters, so a bucket queue
+// with one bucket per meter orders it exactly and only the area inside the
+// budget is ever touched. The boundary wraps the reached nodes and the points
+// where the budget runs out part way along an arc.
+inline Isochrone isochrone(const RoadGraph& graph, TravelMode mode, NodeId from, std::uint32_t budget, SearchState& state)
+{
+    Isochrone result;
+    if(from >= graph.nodeCount())
+    {
+        return result;
+    }
+    const std::uint32_t* weight = graph.weights(mode);
+    std::vector<Point> points;
+    state.start(graph.nodeCount());
+    state.buckets.reset(budget);
+    state.label(from, 0, noNode);
+    state.buckets.push(0, from);
+    while(!state.buckets.empty())
+    {
+        std::uint32_t du;
+        NodeId u = state.buckets.pop(du);
+        if(state.settled(u))
+        {
+            continue;
+        }
+        state.settle(u);
+        result.nodes.push_back(u);
+        result.meters.push_back(du);
+        points.push_back({graph.x(u), graph.y(u)});
+        for(ArcId a = graph.firstOut(u); a < graph.firstOut(u + 1); ++a)
+        {
+            if(weight[a] == blocked)
+            {
+                continue;
+            }
+            NodeId v = graph.head(a);
+            std::uint32_t dv = du + graph.length(a);
+            if(dv > budget)
+            {
+                float t = float(budget - du) / graph.length(a);
+                points.push_back({graph.x(u) + t * (graph.x(v) - graph.x(u)), graph.y(u) + t * (graph.y(v) - graph.y(u))});
+                continue;
+            }
+            if(dv < state.distance(v))
+            {
+                state.label(v, dv, u);
+                state.buckets.push(dv, v);
+            }
+        }
+    }
+    result.boundary = convexHull(points);
+    return result;
+}
+
+// Contraction hierarchy over the car weights. Every node has a rank; each
+// node keeps the arcs to higher ranked nodes, flagged by the direction they
+// may be used in. A shortcut arc stands for the two arcs through `middle`.
+class ContractionHierarchy
+{
+public :
+    struct Arc
+    {
+        NodeId to;
+        std::uint32_t weight;
+        NodeId middle;          // noNode for an original road
+        std::uint32_t flags;    // forwardArc : this node -> to,  backwardArc : to -> this node
+    };
+    static constexpr std::uint32_t forwardArc = 1;
+    static constexpr std::uint32_t backwardArc = 2;
+
+private :
+    std::vector<std::uint32_t> ranks;
+    std::vector<std::uint32_t> firstArcs;
+    std::vector<Arc> arcs;
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t nodeCount;
+        std::uint64_t arcCount;
+        std::uint64_t graphArcCount;  // arcs of the road graph it was built from
+        std::uint64_t weightSum;      // weightChecksum() of that graph
+    };
+    static constexpr char fileMagic[8] = {'R', 'O', 'U', 'T', 'E', 'C', 'H', '\0'};
+    static constexpr std::uint32_t fileVersion = 2;
+
+    // Edge list of the graph while it is being contracted.
+    struct DynArc
+    {
+        NodeId to;
+        std::uint32_t weight;
+        NodeId middle;
+    };
+
+    struct Shortcut
+    {
+        NodeId from, to;
+        std::uint32_t weight;
+        NodeId middle;
+    };
+
+    struct Builder
+    {
+        std::vector<std::vector<DynArc>> out, in;
+        std::vector<std::uint8_t> contracted;
+        std::vector<std::uint8_t> inBatch;  // contracted this round : never a witness for another batch node
+        std::vector<std::uint32_t> deletedNeighbours;
+        std::vector<std::int32_t> priority;
+
+        static constexpr std::size_t witnessSettleLimit = 500;
+
+        static void addArc(std::vector<DynArc>& list, NodeId to, std::uint32_t weight, NodeId middle)
+        {
+            for(DynArc& a : list)
+            {
+                if(a.to == to)
+                {
+                    if(weight < a.weight)
+                    {
+                        a.weight = weight;
+                        a.middle = middle;
+                    }
+                    return;
+                }
+            }
+            list.push_back({to, weight, middle});
+        }
+
+        static void removeArc(std::vector<DynArc>& list, NodeId to)
+        {
+            for(std::size_t i = 0; i < list.size(); ++i)
+            {
+                if(list[i].to == to)
+                {
+                    list[i] = list.back();
+                    list.pop_back();
+                    return;
+                }
+            }
+        }
+
+        // Shortcuts needed if x is contracted now : u -> x -> v is kept unless a
+        // bounded Dijkstra from u that avoids x finds a path that is no longer.
+        // The search also avoids the rest of x's batch : those nodes disappear
+        // in the same round, so two of them must not each rely on the other.
+        void shortcutsFor(NodeId x, SearchState& state, std::vector<Shortcut>& result)
+        {
+            std::uint32_t maxOut = 0;
+            for(const DynArc& o : out[x])
+            {
+                maxOut = std::max(maxOut, o.weight);
+            }
+            for(const DynArc& i : in[x])
+            {
+                NodeId u = i.to;
+                std::uint64_t limit = std::uint64_t(i.weight) + maxOut;
+                state.start(out.size());
+                state.label(u, 0, noNode);
+                state.heap.push(0, u);
+                std::size_t settledCount = 0;
+                while(!state.heap.empty() && settledCount < witnessSettleLimit)
+                {
+                    std::uint32_t key;
+                    NodeId w = state.heap.pop(key);
+                    if(state.settled(w))
+                    {
+                        continue;
+                    }
+                    if(key > limit)
+                    {
+                        break;
+                    }
+                    state.settle(w);
+                    ++settledCount;
+                    for(const DynArc& a : out[w])
+                    {
+                        if(a.to == x || inBatch[a.to])
+                        {
+                            continue;
+                        }
+                        std::uint32_t d = key + a.weight;
+                        if(d < state.distance(a.to))
+                        {
+                            state.label(a.to, d, w);
+                            state.heap.push(d, a.to);
+                        }
+                    }
+                }
+                for(const DynArc& o : out[x])
+                {
+                    std::uint32_t via = i.weight + o.weight;
+                    if(o.to != u && state.distance(o.to) > via)
+                    {
+                        result.push_back({u, o.to, via, x});
+                    }
+                }
+            }
+        }
+
+        // Lower is contracted earlier : favour nodes that add few shortcuts and
+        // spread contraction evenly over the graph.
+        std::int32_t computePriority(NodeId x, SearchState& state, std::vector<Shortcut>& scratch)
+        {
+            scratch.clear();
+            shortcutsFor(x, state, scratch);
+            std::int32_t edgeDifference = static_cast<std::int32_t>(scratch.size()) - static_cast<std::int32_t>(out[x].size() + in[x].size());
+            return 4 * edgeDifference + 2 * static_cast<std::int32_t>(deletedNeighbours[x]);
+        }
+
+        // x may be contracted this round if it beats every uncontracted neighbour.
+        bool isLocalMinimum(NodeId x) const
+        {
+            auto beats = [&](NodeId y)
+            {
+                return priority[x] < priority[y] || (priority[x] == priority[y] && x < y);
+            };
+            for(const DynArc& a : out[x])
+            {
+                if(!beats(a.to))
+                {
+                    return false;
+                }
+            }
+            for(const DynArc& a : in[x])
+            {
+                if(!beats(a.to))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Arc a -> b of the hierarchy with the smallest weight.
+    const Arc* findArc(NodeId a, NodeId b) const
+    {
+        const Arc* best = nullptr;
+        bool fromA = ranks[a] < ranks[b];
+        NodeId at = fromA ? a : b;
+        NodeId other = fromA ? b : a;
+        std::uint32_t flag = fromA ? forwardArc : backwardArc;
+        for(std::uint32_t i = firstArcs[at]; i < firstArcs[at + 1]; ++i)
+        {
+            const Arc& arc = arcs[i];
+            if(arc.to == other && (arc.flags & flag) && (!best || arc.weight < best->weight))
+            {
+                best = &arc;
+            }
+        }
+        return best;
+    }
+
+    // False when a shortcut's halves are missing, which only a bad file can cause.
+    bool unpack(NodeId a, NodeId b, std::vector<NodeId>& path) const
+    {
+        const Arc* arc = findArc(a, b);
+        if(!arc)
+        {
+            return false;
+        }
+        if(arc->middle == noNode)
+        {
+            path.push_back(b);
+            return true;
+        }
+        return unpack(a, arc->middle, path) && unpack(arc->middle, b, path);
+    }
+
+    // Ties a saved hierarchy to the car weights it was contracted with.
+    static std::uint64_t weightChecksum(const RoadGraph& graph)
+    {
+        const std::uint32_t* weight = graph.weights(TravelMode::Car);
+        std::uint64_t sum = 0xcbf29ce484222325ULL;
+        for(ArcId a = 0; a < graph.arcCount(); ++a)
+        {
+            sum = (sum ^ weight[a]) * 0x100000001b3ULL;
+        }
+        return sum;
+    }
+
+    // Every arc goes up in rank to a real node with a known direction, and a
+    // shortcut's middle ranks below both ends, so unpacking always terminates.
+    static bool valid(const std::vector<std::uint32_t>& ranks, const std::vector<std::uint32_t>& firstArcs, const std::vector<Arc>& arcs)
+    {
+        std::size_t n = ranks.size();
+        std::vector<std::uint8_t> seen(n, 0);
+        for(std::uint32_t r : ranks)
+        {
+            if(r >= n || seen[r])
+            {
+                return false;
+            }
+            seen[r] = 1;
+        }
+        if(firstArcs.front() != 0 || firstArcs.back() != arcs.size())
+        {
+            return false;
+        }
+        for(NodeId u = 0; u < n; ++u)
+        {
+            if(firstArcs[u] > firstArcs[u + 1])
+            {
+                return false;
+            }
+            for(std::uint32_t i = firstArcs[u]; i < firstArcs[u + 1]; ++i)
+            {
+                const Arc& arc = arcs[i];
+                if(arc.to >= n || ranks[arc.to] <= ranks[u] || (arc.flags != forwardArc && arc.flags != backwardArc))
+                {
+                    return false;
+                }
+                if(arc.middle != noNode && (arc.middle >= n || ranks[arc.middle] >= ranks[u]))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+public :
+    std::size_t nodeCount() const { return ranks.size(); }
+    std::size_t arcCount() const { return arcs.size(); }
+
+    // Contracts the graph's car network, independent sets of nodes in parallel.
+    void build(const RoadGraph& graph, ThreadPool& pool)
+    {
+        std::size_t n = graph.nodeCount();
+        const std::uint32_t* weight = graph.weights(TravelMode::Car);
+        Builder b;
+        b.out.resize(n);
+        b.in.resize(n);
+        b.contracted.assign(n, 0);
+        b.inBatch.assign(n, 0);
+        b.deletedNeighbours.assign(n, 0);
+        b.priority.assign(n, 0);
+        for(NodeId u = 0; u < n; ++u)
+        {
+            for(ArcId a = graph.firstOut(u); a < graph.firstOut(u + 1); ++a)
+            {
+                NodeId v = graph.head(a);
+                if(weight[a] == blocked || v == u)
+                {
+                    continue;
+                }
+                Builder::addArc(b.out[u], v, weight[a], noNode);
+                Builder::addArc(b.in[v], u, weight[a], noNode);
+            }
+        }
+
+        unsigned slots = pool.size();
+        std::vector<SearchState> states(slots);
+        std::vector<std::vector<Shortcut>> found(slots);
+        std::vector<NodeId> remaining(n);
+        for(NodeId v = 0; v < n; ++v)
+        {
+            remaining[v] = v;
+        }
+        auto forEach = [&](const std::vector<NodeId>& nodes, const std::function<void(NodeId, std::size_t)>& fn)
+        {
+            pool.run(slots, [&](std::size_t slot)
+            {
+                for(std::size_t i = slot; i < nodes.size(); i += slots)
+                {
+                    fn(nodes[i], slot);
+                }
+            });
+        };
+        forEach(remaining, [&](NodeId v, std::size_t slot)
+        {
+            std::vector<Shortcut> scratch;
+            b.priority[v] = b.computePriority(v, states[slot], scratch);
+        });
+
+        ranks.assign(n, 0);
+        std::vector<std::vector<DynArc>> upOut(n), upIn(n);
+        std::uint32_t nextRank = 0;
+        std::vector<NodeId> batch, touched;
+        std::vector<std::uint8_t> isTouched(n, 0);
+        while(!remaining.empty())
+        {
+            batch.clear();
+            for(NodeId v : remaining)
+            {
+                if(b.isLocalMinimum(v))
+                {
+                    batch.push_back(v);
+                }
+            }
+
+            for(std::vector<Shortcut>& f : found)
+            {
+                f.clear();
+            }
+            for(NodeId x : batch)
+            {
+                b.inBatch[x] = 1;
+            }
+            forEach(batch, [&](NodeId x, std::size_t slot)
+            {
+                b.shortcutsFor(x, states[slot], found[slot]);
+            });
+            for(NodeId x : batch)
+            {
+                b.inBatch[x] = 0;
+            }
+
+            // apply serially : nodes of one batch share neighbours
+            touched.clear();
+            for(NodeId x : batch)
+            {
+                ranks[x] = nextRank++;
+                b.contracted[x] = 1;
+                for(const DynArc& a : b.out[x])
+                {
+                    Builder::removeArc(b.in[a.to], x);
+                    ++b.deletedNeighbours[a.to];
+                    if(!isTouched[a.to]) { isTouched[a.to] = 1; touched.push_back(a.to); }
+                }
+                for(const DynArc& a : b.in[x])
+                {
+                    Builder::removeArc(b.out[a.to], x);
+                    ++b.deletedNeighbours[a.to];
+                    if(!isTouched[a.to]) { isTouched[a.to] = 1; touched.push_back(a.to); }
+                }
+                upOut[x] = std::move(b.out[x]);
+                upIn[x] = std::move(b.in[x]);
+            }
+            for(const std::vector<Shortcut>& f : found)
+            {
+                for(const Shortcut& s : f)
+                {
+                    Builder::addArc(b.out[s.from], s.to, s.weight, s.middle);
+                    Builder::addArc(b.in[s.to], s.from, s.weight, s.middle);
+                }
+            }
+
+            remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&](NodeId v){ return b.contracted[v] != 0; }), remaining.end());
+            for(NodeId v : touched)
+            {
+                isTouched[v] = 0;
+            }
+            touched.erase(std::remove_if(touched.begin(), touched.end(), [&](NodeId v){ return b.contracted[v] != 0; }), touched.end());
+            forEach(touched, [&](NodeId v, std::size_t slot)
+            {
+                std::vector<Shortcut> scratch;
+                b.priority[v] = b.computePriority(v, states[slot], scratch);
+            });
+        }
+
+        firstArcs.assign(n + 1, 0);
+        for(NodeId v = 0; v < n; ++v)
+        {
+            firstArcs[v + 1] = firstArcs[v] + static_cast<std::uint32_t>(upOut[v].size() + upIn[v].size());
+        }
+        arcs.resize(firstArcs[n]);
+        for(NodeId v = 0; v < n; ++v)
+        {
+            std::uint32_t i = firstArcs[v];
+            for(const DynArc& a : upOut[v])
+            {
+                arcs[i++] = {a.to, a.weight, a.middle, forwardArc};
+            }
+            for(const DynArc& a : upIn[v])
+            {
+                arcs[i++] = {a.to, a.weight, a.middle, backwardArc};
+            }
+        }
+    }
+
+    bool save(const std::string& path, const RoadGraph& graph) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        FileHeader header;
+        std::copy(fileMagic, fileMagic + 8, header.magic);
+        header.version = fileVersion;
+        header.nodeCount = static_cast<std::uint32_t>(ranks.size());
+        header.arcCount = arcs.size();
+        header.graphArcCount = graph.arcCount();
+        header.weightSum = weightChecksum(graph);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(ranks.data()), ranks.size() * sizeof(std::uint32_t));
+        out.write(reinterpret_cast<const char*>(firstArcs.data()), firstArcs.size() * sizeof(std::uint32_t));
+        out.write(reinterpret_cast<const char*>(arcs.data()), arcs.size() * sizeof(Arc));
+        return static_cast<bool>(out);
+    }
+
+    // Fails unless the file was built from this graph's car weights and is
+    // well formed; the hierarchy is left untouched on failure.
+    bool load(const std::string& path, const RoadGraph& graph)
+    {
+        std::ifstream in(path, std::ios::binary);
+        FileHeader header;
+        if(!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || !std::equal(fileMagic, fileMagic + 8, header.magic) ||
+           header.version != fileVersion || header.nodeCount != graph.nodeCount() || header.graphArcCount != graph.arcCount() ||
+           header.weightSum != weightChecksum(graph) || header.arcCount > std::numeric_limits<std::uint32_t>::max())
+        {
+            return false;
+        }
+        std::vector<std::uint32_t> fileRanks(header.nodeCount);
+        std::vector<std::uint32_t> fileFirstArcs(std::size_t(header.nodeCount) + 1);
+        in.read(reinterpret_cast<char*>(fileRanks.data()), fileRanks.size() * sizeof(std::uint32_t));
+        in.read(reinterpret_cast<char*>(fileFirstArcs.data()), fileFirstArcs.size() * sizeof(std::uint32_t));
+        if(!in || fileFirstArcs.back() != header.arcCount)
+        {
+            return false;
+        }
+        std::vector<Arc> fileArcs(header.arcCount);
+        if(!in.read(reinterpret_cast<char*>(fileArcs.data()), fileArcs.size() * sizeof(Arc)) || !valid(fileRanks, fileFirstArcs, fileArcs))
+        {
+            return false;
+        }
+        ranks.swap(fileRanks);
+        firstArcs.swap(fileFirstArcs);
+        arcs.swap(fileArcs);
+        return true;
+    }
+
+    // Full upward search from `from` along arcs with `direction`, with stall-on-demand.
+    // visit(node, distance) is called for every node settled unstalled.
+    template<typename Visit>
+    void upwardSearch(NodeId from, std::uint32_t direction, SearchState& state, Visit visit) const
+    {
+        std::uint32_t stallFlag = direction == forwardArc ? backwardArc : forwardArc;
+        state.start(nodeCount());
+        state.label(from, 0, noNode);
+        state.heap.push(0, from);
+        while(!state.heap.empty())
+        {
+            std::uint32_t key;
+            NodeId u = state.heap.pop(key);
+            if(state.settled(u))
+            {
+                continue;
+            }
+            state.settle(u);
+            bool stalled = false;
+            for(std::uint32_t i = firstArcs[u]; i < firstArcs[u + 1] && !stalled; ++i)
+            {
+                std::uint32_t dx = state.distance(arcs[i].to);
+                stalled = (arcs[i].flags & stallFlag) && dx != unreachable && dx + arcs[i].weight < key;
+            }
+            if(stalled)
+            {
+                continue;
+            }
+            visit(u, key);
+            for(std::uint32_t i = firstArcs[u]; i < firstArcs[u + 1]; ++i)
+            {
+                const Arc& arc = arcs[i];
+                std::uint32_t d = key + arc.weight;
+                if((arc.flags & direction) && d < state.distance(arc.to))
+                {
+                    state.label(arc.to, d, u);
+                    state.heap.push(d, arc.to);
+                }
+            }
+        }
+    }
+
+    // Bucket based many-to-many : the backward upward search of every target
+    // leaves (target, distance) in the buckets of the nodes it settles, then the
+    // forward upward search of each source scans the buckets it reaches.
+    void manyToMany(const std::vector<NodeId>& sources, const std::vector<NodeId>& targets, ThreadPool& pool,
+                    DistanceMatrix& matrix) const
+    {
+        struct BucketEntry
+        {
+            NodeId node;
+            std::uint32_t target;
+            std::uint32_t distance;
+        };
+        matrix.reset(sources.size(), targets.size());
+        std::size_t slots = pool.size();
+        std::vector<SearchState> states(slots);
+        std::vector<std::vector<BucketEntry>> found(slots);
+        pool.run(slots, [&](std::size_t slot)
+        {
+            for(std::size_t c = slot; c < targets.size(); c += slots)
+            {
+                if(targets[c] < nodeCount())
+                {
+                    upwardSearch(targets[c], backwardArc, states[slot], [&](NodeId v, std::uint32_t d)
+                    {
+                        found[slot].push_back({v, static_cast<std::uint32_t>(c), d});
+                    });
+                }
+            }
+        });
+
+        std::vector<std::uint32_t> firstEntry(nodeCount() + 1, 0);
+        for(const std::vector<BucketEntry>& f : found)
+        {
+            for(const BucketEntry& e : f)
+            {
+                ++firstEntry[e.node + 1];
+            }
+        }
+        for(std::size_t v = 0; v < nodeCount(); ++v)
+        {
+            firstEntry[v + 1] += firstEntry[v];
+        }
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> buckets(firstEntry[nodeCount()]);
+        std::vector<std::uint32_t> next(firstEntry.begin(), firstEntry.end() - 1);
+        for(std::vector<BucketEntry>& f : found)
+        {
+            for(const BucketEntry& e : f)
+            {
+                buckets[next[e.node]++] = {e.target, e.distance};
+            }
+            f = {};
+        }
+
+        pool.run(slots, [&](std::size_t slot)
+        {
+            for(std::size_t r = slot; r < sources.size(); r += slots)
+            {
+                if(sources[r] >= nodeCount())
+                {
+                    continue;
+                }
+                std::uint32_t* row = matrix.values.data() + r * matrix.cols;
+                upwardSearch(sources[r], forwardArc, states[slot], [&](NodeId v, std::uint32_t d)
+                {
+                    for(std::uint32_t i = firstEntry[v]; i < firstEntry[v + 1]; ++i)
+                    {
+                        row[buckets[i].first] = std::min(row[buckets[i].first], d + buckets[i].second);
+                    }
+                });
+            }
+        });
+    }
+
+    // Bidirectional Dijkstra that only climbs in rank; a direction stops once
+    // its queue minimum reaches the best meeting cost. Nodes reached suboptimally
+    // through a higher node are stalled and not expanded. Returns the cost and
+    // the node where the two searches met, noNode if they did not.
+    std::uint32_t queryCost(NodeId from, NodeId to, SearchState& forward, SearchState& backward, NodeId& meet) const
+    {
+        meet = noNode;
+        if(from >= nodeCount() || to >= nodeCount())
+        {
+            return unreachable;
+        }
+        forward.start(nodeCount());
+        backward.start(nodeCount());
+        forward.label(from, 0, noNode);
+        forward.heap.push(0, from);
+        backward.label(to, 0, noNode);
+        backward.heap.push(0, to);
+
+        std::uint32_t best = unreachable;
+        bool forwardOpen = true, backwardOpen = true;
+        while(forwardOpen || backwardOpen)
+        {
+            for(int side = 0; side < 2; ++side)
+            {
+                bool& open = side == 0 ? forwardOpen : backwardOpen;
+                SearchState& self = side == 0 ? forward : backward;
+                SearchState& other = side == 0 ? backward : forward;
+                std::uint32_t relaxFlag = side == 0 ? forwardArc : backwardArc;
+                std::uint32_t stallFlag = side == 0 ? backwardArc : forwardArc;
+                if(!open)
+                {
+                    continue;
+                }
+                if(self.heap.empty())
+                {
+                    open = false;
+                    continue;
+                }
+                std::uint32_t key;
+                NodeId u = self.heap.pop(key);
+                if(self.settled(u))
+                {
+                    continue;
+                }
+                if(key >= best)
+                {
+                    open = false;
+                    continue;
+                }
+                self.settle(u);
+                std::uint32_t otherDistance = other.distance(u);
+                if(otherDistance != unreachable && key + otherDistance < best)
+                {
+                    best = key + otherDistance;
+                    meet = u;
+                }
+                bool stalled = false;
+                for(std::uint32_t i = firstArcs[u]; i < firstArcs[u + 1] && !stalled; ++i)
+                {
+                    const Arc& arc = arcs[i];
+                    std::uint32_t dx = self.distance(arc.to);
+                    stalled = (arc.flags & stallFlag) && dx != unreachable && dx + arc.weight < key;
+                }
+                if(stalled)
+                {
+                    continue;
+                }
+                for(std::uint32_t i = firstArcs[u]; i < firstArcs[u + 1]; ++i)
+                {
+                    const Arc& arc = arcs[i];
+                    if(!(arc.flags & relaxFlag))
+                    {
+                        continue;
+                    }
+                    std::uint32_t d = key + arc.weight;
+                    if(d < self.distance(arc.to))
+                    {
+                        self.label(arc.to, d, u);
+                        self.heap.push(d, arc.to);
+                    }
+                }
+            }
+        }
+
+        return best;
+    }
+
+    Route query(NodeId from, NodeId to, SearchState& forward, SearchState& backward) const
+    {
+        Route route;
+        NodeId meet;
+        route.cost = queryCost(from, to, forward, backward, meet);
+        if(meet == noNode)
+        {
+            return route;
+        }
+        std::vector<NodeId> up;
+        for(NodeId v = meet; v != noNode; v = forward.parent(v))
+        {
+            up.push_back(v);
+        }
+        std::reverse(up.begin(), up.end());
+        route.path.push_back(from);
+        bool unpacked = true;
+        for(std::size_t i = 1; i < up.size() && unpacked; ++i)
+        {
+            unpacked = unpack(up[i - 1], up[i], route.path);
+        }
+        for(NodeId v = meet; backward.parent(v) != noNode && unpacked; v = backward.parent(v))
+        {
+            unpacked = unpack(v, backward.parent(v), route.path);
+        }
+        return unpacked ? route : Route();
+    }
+};
+
+// Customizable contraction hierarchy for the car network. The node order comes
+// from a nested dissection of the map and the upward arcs are its chordal fill,
+// so both depend on the topology alone and are computed once. Weights live in a
+// Metric produced by customize(), which is cheap enough to rerun every time the
+// traffic weights change. Internally nodes are numbered by rank.
+class CustomizableHierarchy
+{
+public :
+    // Weights of every upward arc lo -> hi in both directions, and the lower
+    // node a shortcut passes through (noNode for a road).
+    struct Metric
+    {
+        std::vector<std::uint32_t> forward, backward;   // lo -> hi, hi -> lo
+        std::vector<NodeId> forwardMiddle, backwardMiddle;
+    };
+
+private :
+    std::vector<std::uint32_t> ranks;     // node -> rank
+    std::vector<NodeId> order;            // rank -> node
+    std::vector<std::uint32_t> firstUp;   // upward arcs of a rank, heads ascending
+    std::vector<std::uint32_t> upHeads;
+    std::vector<std::uint32_t> firstDown; // lower neighbours of a rank, ascending, with the arc to this rank
+    std::vector<std::uint32_t> downTails;
+    std::vector<std::uint32_t> downArcs;
+    std::vector<std::uint32_t> parents;   // elimination tree : lowest upward neighbour
+    std::vector<std::uint32_t> firstInLevel;
+    std::vector<std::uint32_t> levelRanks;
+    std::vector<std::uint32_t> graphArcSlots;  // graph arc -> 2 * upward arc + direction, blocked if unused
+
+    static constexpr std::uint32_t selfLoop = blocked - 1;  // slot of a u -> u arc : never on a shortest path
+
+    static constexpr std::size_t leafSize = 4;
+
+    // Orders `part` : both halves of a median cut first, then the nodes of one
+    // half that touch the other, which separate them.
+    void dissect(const RoadGraph& graph, const std::vector<std::uint32_t>& firstAdjacent, const std::vector<NodeId>& adjacent,
+                 std::vector<NodeId>& part, std::vector<std::uint8_t>& side)
+    {
+        if(part.size() <= leafSize)
+        {
+            order.insert(order.end(), part.begin(), part.end());
+            return;
+        }
+        float minX = std::numeric_limits<float>::max(), maxX = std::numeric_limits<float>::lowest();
+        float minY = minX, maxY = maxX;
+        for(NodeId v : part)
+        {
+            minX = std::min(minX, graph.x(v));
+            maxX = std::max(maxX, graph.x(v));
+            minY = std::min(minY, graph.y(v));
+            maxY = std::max(maxY, graph.y(v));
+        }
+        bool alongX = maxX - minX >= maxY - minY;
+        auto middle = part.begin() + static_cast<std::ptrdiff_t>(part.size() / 2);
+        std::nth_element(part.begin(), middle, part.end(), [&](NodeId a, NodeId b)
+        {
+            return alongX ? graph.x(a) < graph.x(b) : graph.y(a) < graph.y(b);
+        });
+
+        std::vector<NodeId> low(part.begin(), middle), high, separator;
+        for(NodeId v : low)
+        {
+            side[v] = 1;
+        }
+        for(auto it = middle; it != part.end(); ++it)
+        {
+            bool touchesLow = false;
+            for(std::uint32_t i = firstAdjacent[*it]; i < firstAdjacent[*it + 1] && !touchesLow; ++i)
+            {
+                touchesLow = side[adjacent[i]] == 1;
+            }
+            (touchesLow ? separator : high).push_back(*it);
+        }
+        for(NodeId v : low)
+        {
+            side[v] = 0;
+        }
+        part.clear();
+        part.shrink_to_fit();
+        dissect(graph, firstAdjacent, adjacent, low, side);
+        dissect(graph, firstAdjacent, adjacent, high, side);
+        order.insert(order.end(), separator.begin(), separator.end());
+    }
+
+    std::uint32_t findUp(std::uint32_t lo, std::uint32_t hi) const
+    {
+        auto begin = upHeads.begin() + firstUp[lo], end = upHeads.begin() + firstUp[lo + 1];
+        return static_cast<std::uint32_t>(std::lower_bound(begin, end, hi) - upHeads.begin());
+    }
+
+    // Relaxes every upward arc of the ranks on the elimination tree path above
+    // `rank`, which is exactly the upward search space of that rank.
+    template<typename Visit>
+    void sweep(std::uint32_t rank, const std::vector<std::uint32_t>& weight, SearchState& state, Visit visit) const
+    {
+        state.start(nodeCount());
+        state.label(rank, 0, noNode);
+        for(std::uint32_t x = rank; x != noNode; x = parents[x])
+        {
+            std::uint32_t d = state.distance(x);
+            if(d == unreachable)
+            {
+                continue;
+            }
+            visit(x, d);
+            for(std::uint32_t a = firstUp[x]; a < firstUp[x + 1]; ++a)
+            {
+                if(weight[a] == unreachable)
+                {
+                    continue;
+                }
+                std::uint32_t nd = d + weight[a];
+                if(nd < state.distance(upHeads[a]))
+                {
+                    state.label(upHeads[a], nd, x);
+                }
+            }
+        }
+    }
+
+    void unpack(std::uint32_t from, std::uint32_t to, const Metric& metric, std::vector<NodeId>& path) const
+    {
+        NodeId middle = from < to ? metric.forwardMiddle[findUp(from, to)] : metric.backwardMiddle[findUp(to, from)];
+        if(middle == noNode)
+        {
+            path.push_back(order[to]);
+            return;
+        }
+        unpack(from, middle, metric, path);
+        unpack(middle, to, metric, path);
+    }
+
+public :
+    std::size_t nodeCount() const { return order.size(); }
+    std::size_t arcCount() const { return upHeads.size(); }
+    std::size_t levelCount() const { return firstInLevel.empty() ? 0 : firstInLevel.size() - 1; }
+
+    // False for graph arcs that were blocked for cars when the topology was
+    // built : no weight given to them can take effect without a rebuild.
+    bool covers(ArcId a) const { return a < graphArcSlots.size() && graphArcSlots[a] != blocked; }
+
+    // Topology of the car network : arcs blocked for cars in the graph never
+    // take part, whatever weight a traffic update gives them.
+    void build(const RoadGraph& graph)
+    {
+        std::size_t n = graph.nodeCount();
+        const std::uint32_t* weight = graph.weights(TravelMode::Car);
+
+        std::vector<std::pair<NodeId, NodeId>> edges;
+        for(NodeId u = 0; u < n; ++u)
+        {
+            for(ArcId a = graph.firstOut(u); a < graph.firstOut(u + 1); ++a)
+            {
+                NodeId v = graph.head(a);
+                if(weight[a] != blocked && u != v)
+                {
+                    edges.push_back({u, v});
+                    edges.push_back({v, u});
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        std::vector<std::uint32_t> firstAdjacent(n + 1, 0);
+        std::vector<NodeId> adjacent(edges.size());
+        for(std::size_t i = 0; i < edges.size(); ++i)
+        {
+            ++firstAdjacent[edges[i].first + 1];
+            adjacent[i] = edges[i].second;
+        }
+        for(std::size_t v = 0; v < n; ++v)
+        {
+            firstAdjacent[v + 1] += firstAdjacent[v];
+        }
+
+        order.clear();
+        order.reserve(n);
+        std::vector<NodeId> all(n);
+        for(NodeId v = 0; v < n; ++v)
+        {
+            all[v] = v;
+        }
+        std::vector<std::uint8_t> side(n, 0);
+        dissect(graph, firstAdjacent, adjacent, all, side);
+        ranks.assign(n, 0);
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            ranks[order[r]] = r;
+        }
+
+        // Chordal fill : eliminating a rank links its upward neighbours into a
+        // clique; handing them to the lowest one is enough, since it passes them on.
+        std::vector<std::vector<std::uint32_t>> up(n);
+        for(const auto& e : edges)
+        {
+            if(ranks[e.first] < ranks[e.second])
+            {
+                up[ranks[e.first]].push_back(ranks[e.second]);
+            }
+        }
+        edges = {};
+        parents.assign(n, noNode);
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            std::sort(up[r].begin(), up[r].end());
+            up[r].erase(std::unique(up[r].begin(), up[r].end()), up[r].end());
+            if(up[r].empty())
+            {
+                continue;
+            }
+            parents[r] = up[r][0];
+            up[parents[r]].insert(up[parents[r]].end(), up[r].begin() + 1, up[r].end());
+        }
+
+        firstUp.assign(n + 1, 0);
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            firstUp[r + 1] = firstUp[r] + static_cast<std::uint32_t>(up[r].size());
+        }
+        upHeads.clear();
+        upHeads.reserve(firstUp[n]);
+        firstDown.assign(n + 1, 0);
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            upHeads.insert(upHeads.end(), up[r].begin(), up[r].end());
+            for(std::uint32_t h : up[r])
+            {
+                ++firstDown[h + 1];
+            }
+            up[r] = {};
+        }
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            firstDown[r + 1] += firstDown[r];
+        }
+        downTails.resize(upHeads.size());
+        downArcs.resize(upHeads.size());
+        std::vector<std::uint32_t> next(firstDown.begin(), firstDown.end() - 1);
+        std::vector<std::uint32_t> level(n, 0);
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            for(std::uint32_t a = firstUp[r]; a < firstUp[r + 1]; ++a)
+            {
+                std::uint32_t h = upHeads[a];
+                downTails[next[h]] = r;
+                downArcs[next[h]++] = a;
+                level[h] = std::max(level[h], level[r] + 1);
+            }
+        }
+
+        // Ranks on one level share no arc, so customize() handles a level in parallel.
+        std::uint32_t levels = n ? *std::max_element(level.begin(), level.end()) + 1 : 0;
+        firstInLevel.assign(levels + 1, 0);
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            ++firstInLevel[level[r] + 1];
+        }
+        for(std::uint32_t l = 0; l < levels; ++l)
+        {
+            firstInLevel[l + 1] += firstInLevel[l];
+        }
+        levelRanks.resize(n);
+        next.assign(firstInLevel.begin(), firstInLevel.end() - 1);
+        for(std::uint32_t r = 0; r < n; ++r)
+        {
+            levelRanks[next[level[r]]++] = r;
+        }
+
+        graphArcSlots.assign(graph.arcCount(), blocked);
+        for(NodeId u = 0; u < n; ++u)
+        {
+            for(ArcId a = graph.firstOut(u); a < graph.firstOut(u + 1); ++a)
+            {
+                std::uint32_t ru = ranks[u], rv = ranks[graph.head(a)];
+                if(weight[a] != blocked)
+                {
+                    graphArcSlots[a] = ru == rv ? selfLoop : ru < rv ? 2 * findUp(ru, rv) : 2 * findUp(rv, ru) + 1;
+                }
+            }
+        }
+    }
+
+    // Metric for car weights given per graph arc (blocked closes the road).
+    // Each upward arc takes the cheaper of its road and the lower triangles
+    // below it; a rank finishes its upward arcs once its level is reached, as
+    // every triangle it needs belongs to a lower level.
+    std::shared_ptr<const Metric> customize(const std::vector<std::uint32_t>& weights, ThreadPool& pool) const
+    {
+        auto metric = std::make_shared<Metric>();
+        Metric& m = *metric;
+        m.forward.assign(arcCount(), unreachable);
+        m.backward.assign(arcCount(), unreachable);
+        m.forwardMiddle.assign(arcCount(), noNode);
+        m.backwardMiddle.assign(arcCount(), noNode);
+        for(std::size_t a = 0; a < graphArcSlots.size(); ++a)
+        {
+            std::uint32_t slot = graphArcSlots[a];
+            if(slot == blocked || slot == selfLoop || weights[a] == blocked)
+            {
+                continue;
+            }
+            std::uint32_t& w = (slot & 1) ? m.backward[slot >> 1] : m.forward[slot >> 1];
+            w = std::min(w, weights[a]);
+        }
+
+        // Lower triangles u < v < w of arc v -> w : the arcs u - v are marked
+        // first, then the lower neighbours of w below v are looked up.
+        std::size_t slots = pool.size();
+        std::vector<std::vector<std::uint32_t>> arcToV(slots, std::vector<std::uint32_t>(nodeCount(), noNode));
+        auto customizeRank = [&](std::uint32_t v, std::vector<std::uint32_t>& toV)
+        {
+            for(std::uint32_t i = firstDown[v]; i < firstDown[v + 1]; ++i)
+            {
+                toV[downTails[i]] = downArcs[i];
+            }
+            for(std::uint32_t a = firstUp[v]; a < firstUp[v + 1]; ++a)
+            {
+                std::uint32_t w = upHeads[a];
+                std::uint32_t forward = m.forward[a], backward = m.backward[a];
+                NodeId forwardMiddle = m.forwardMiddle[a], backwardMiddle = m.backwardMiddle[a];
+                for(std::uint32_t j = firstDown[w]; j < firstDown[w + 1] && downTails[j] < v; ++j)
+                {
+                    std::uint32_t u = downTails[j];
+                    std::uint32_t uv = toV[u];
+                    if(uv == noNode)
+                    {
+                        continue;
+                    }
+                    std::uint32_t uw = downArcs[j];
+                    if(m.backward[uv] != unreachable && m.forward[uw] != unreachable && m.backward[uv] + m.forward[uw] < forward)
+                    {
+                        forward = m.backward[uv] + m.forward[uw];
+                        forwardMiddle = u;
+                    }
+                    if(m.backward[uw] != unreachable && m.forward[uv] != unreachable && m.backward[uw] + m.forward[uv] < backward)
+                    {
+                        backward = m.backward[uw] + m.forward[uv];
+                        backwardMiddle = u;
+                    }
+                }
+                m.forward[a] = forward;
+                m.backward[a] = backward;
+                m.forwardMiddle[a] = forwardMiddle;
+                m.backwardMiddle[a] = backwardMiddle;
+            }
+            for(std::uint32_t i = firstDown[v]; i < firstDown[v + 1]; ++i)
+            {
+                toV[downTails[i]] = noNode;
+            }
+        };
+
+        constexpr std::uint32_t parallelLevel = 256;
+        for(std::size_t l = 0; l < levelCount(); ++l)
+        {
+            std::uint32_t begin = firstInLevel[l], end = firstInLevel[l + 1];
+            if(end - begin < parallelLevel || slots == 1)
+            {
+                for(std::uint32_t i = begin; i < end; ++i)
+                {
+                    customizeRank(levelRanks[i], arcToV[0]);
+                }
+                continue;
+            }
+            pool.run(slots, [&](std::size_t slot)
+            {
+                for(std::uint32_t i = begin + static_cast<std::uint32_t>(slot); i < end; i += static_cast<std::uint32_t>(slots))
+                {
+                    customizeRank(levelRanks[i], arcToV[slot]);
+                }
+            });
+        }
+        return metric;
+    }
+
+    // Forward sweep from the origin, backward sweep from the destination; the
+    // route meets on an elimination tree ancestor common to both. `meet` is
+    // that ancestor's rank, noNode without a route.
+    std::uint32_t queryCost(NodeId from, NodeId to, const Metric& metric, SearchState& forward, SearchState& backward,
+                            std::uint32_t& meet) const
+    {
+        meet = noNode;
+        if(from >= nodeCount() || to >= nodeCount())
+        {
+            return unreachable;
+        }
+        std::uint32_t best = unreachable;
+        sweep(ranks[to], metric.backward, backward, [](std::uint32_t, std::uint32_t) {});
+        sweep(ranks[from], metric.forward, forward, [&](std::uint32_t x, std::uint32_t d)
+        {
+            std::uint32_t other = backward.distance(x);
+            if(other != unreachable && d + other < best)
+            {
+                best = d + other;
+                meet = x;
+            }
+        });
+        return best;
+    }
+
+    Route query(NodeId from, NodeId to, const Metric& metric, SearchState& forward, SearchState& backward) const
+    {
+        Route route;
+        std::uint32_t meet;
+        route.cost = queryCost(from, to, metric, forward, backward, meet);
+        if(meet == noNode)
+        {
+            return route;
+        }
+        std::vector<std::uint32_t> up;
+        for(std::uint32_t x = meet; x != noNode; x = forward.parent(x))
+        {
+            up.push_back(x);
+        }
+        std::reverse(up.begin(), up.end());
+        route.path.push_back(from);
+        for(std::size_t i = 1; i < up.size(); ++i)
+        {
+            unpack(up[i - 1], up[i], metric, route.path);
+        }
+        for(std::uint32_t x = meet; backward.parent(x) != noNode; x = backward.parent(x))
+        {
+            unpack(x, backward.parent(x), metric, route.path);
+        }
+        return route;
+    }
+
+    // Same bucket scheme as ContractionHierarchy::manyToMany, with the
+    // elimination tree sweeps as search spaces.
+    void manyToMany(const std::vector<NodeId>& sources, const std::vector<NodeId>& targets, const Metric& metric,
+                    ThreadPool& pool, DistanceMatrix& matrix) const
+    {
+        matrix.reset(sources.size(), targets.size());
+        std::size_t slots = pool.size();
+        std::vector<SearchState> states(slots);
+        std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> found(slots);  // (rank, target), distance in parallel
+        std::vector<std::vector<std::uint32_t>> foundDistance(slots);
+        pool.run(slots, [&](std::size_t slot)
+        {
+            for(std::size_t c = slot; c < targets.size(); c += slots)
+            {
+                if(targets[c] < nodeCount())
+                {
+                    sweep(ranks[targets[c]], metric.backward, states[slot], [&](std::uint32_t x, std::uint32_t d)
+                    {
+                        found[slot].push_back({x, static_cast<std::uint32_t>(c)});
+                        foundDistance[slot].push_back(d);
+                    });
+                }
+            }
+        });
+
+        std::vector<std::uint32_t> firstEntry(nodeCount() + 1, 0);
+        for(const auto& f : found)
+        {
+            for(const auto& e : f)
+            {
+                ++firstEntry[e.first + 1];
+            }
+        }
+        for(std::size_t x = 0; x < nodeCount(); ++x)
+        {
+            firstEntry[x + 1] += firstEntry[x];
+        }
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> buckets(firstEntry[nodeCount()]);
+        std::vector<std::uint32_t> next(firstEntry.begin(), firstEntry.end() - 1);
+        for(std::size_t slot = 0; slot < slots; ++slot)
+        {
+            for(std::size_t i = 0; i < found[slot].size(); ++i)
+            {
+                buckets[next[found[slot][i].first]++] = {found[slot][i].second, foundDistance[slot][i]};
+            }
+            found[slot] = {};
+            foundDistance[slot] = {};
+        }
+
+        pool.run(slots, [&](std::size_t slot)
+        {
+            for(std::size_t r = slot; r < sources.size(); r += slots)
+            {
+                if(sources[r] >= nodeCount())
+                {
+                    continue;
+                }
+                std::uint32_t* row = matrix.values.data() + r * matrix.cols;
+                sweep(ranks[sources[r]], metric.forward, states[slot], [&](std::uint32_t x, std::uint32_t d)
+                {
+                    for(std::uint32_t i = firstEntry[x]; i < firstEntry[x + 1]; ++i)
+                    {
+                        row[buckets[i].first] = std::min(row[buckets[i].first], d + buckets[i].second);
+                    }
+                });
+            }
+        });
+    }
+};
+
+// Car weights that change while routes are being served. update() customizes
+// a new metric next to the current one and then swaps the pointer, so a query
+// keeps the snapshot it started with until it finishes.
+class LiveTraffic
+{
+    std::shared_ptr<const CustomizableHierarchy> hierarchy;
+    mutable std::mutex mtx;
+    std::shared_ptr<const CustomizableHierarchy::Metric> metric;
+    std::mutex updateMtx;
+    std::vector<std::uint32_t> weights;  // by graph arc, what `metric` was customized with
+
+public :
+    LiveTraffic(std::shared_ptr<const CustomizableHierarchy> cch, const RoadGraph& graph, ThreadPool& pool)
+        : hierarchy(std::move(cch)),
+          weights(graph.weights(TravelMode::Car), graph.weights(TravelMode::Car) + graph.arcCount())
+    {
+        metric = hierarchy->customize(weights, pool);
+    }
+
+    const CustomizableHierarchy& topology() const { return *hierarchy; }
+
+    std::shared_ptr<const CustomizableHierarchy::Metric> current() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return metric;
+    }
+
+    // Applies a full weight vector and fills `changed` with the graph arcs whose
+    // weight changed. Returns false and keeps the current metric when the vector
+    // does not hold one weight per graph arc, or when it reopens an arc the
+    // topology was built without; `changed` is left empty then.
+    bool update(std::vector<std::uint32_t> newWeights, ThreadPool& pool, std::vector<ArcId>& changed)
+    {
+        std::lock_guard<std::mutex> serial(updateMtx);
+        changed.clear();
+        if(newWeights.size() != weights.size())
+        {
+            return false;
+        }
+        for(std::size_t a = 0; a < weights.size(); ++a)
+        {
+            if(weights[a] == newWeights[a])
+            {
+                continue;
+            }
+            if(!hierarchy->covers(static_cast<ArcId>(a)) && newWeights[a] != blocked)
+            {
+                changed.clear();
+                return false;
+            }
+            changed.push_back(static_cast<ArcId>(a));
+        }
+        if(changed.empty())
+        {
+            return true;
+        }
+        std::shared_ptr<const CustomizableHierarchy::Metric> next = hierarchy->customize(newWeights, pool);
+        weights = std::move(newWeights);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            metric.swap(next);
+        }
+        return true;
+    }
+};
+
+// Square cells of the map used to invalidate cached routes : a traffic update
+// names the tiles it touched.
+using TileId = std::uint64_t;
+constexpr float tileMeters = 1000.0f;
+
+inline TileId tileAt(float x, float y)
+{
+    std::uint32_t tx = static_cast<std::uint32_t>(static_cast<std::int32_t>(std::floor(x / tileMeters)));
+    std::uint32_t ty = static_cast<std::uint32_t>(static_cast<std::int32_t>(std::floor(y / tileMeters)));
+    return (TileId(tx) << 32) | ty;
+}
+
+// Nearest node to a coordinate, through a uniform grid of buckets.
+class NodeLocator
+{
+    const RoadGraph* graph = nullptr;
+    float minX = 0, minY = 0;
+    float cell = 250.0f;
+    std::size_t columns = 1, rows = 1;
+    std::vector<std::uint32_t> firstInCell;
+    std::vector<NodeId> nodes;
+
+    std::size_t cellOf(float x, float y) const
+    {
+        std::size_t cx = static_cast<std::size_t>(std::clamp((x - minX) / cell, 0.0f, float(columns - 1)));
+        std::size_t cy = static_cast<std::size_t>(std::clamp((y - minY) / cell, 0.0f, float(rows - 1)));
+        return cy * columns + cx;
+    }
+
+public :
+    void build(const RoadGraph& g)
+    {
+        graph = &g;
+        float maxX = 0, maxY = 0;
+        minX = minY = std::numeric_limits<float>::max();
+        maxX = maxY = std::numeric_limits<float>::lowest();
+        for(NodeId v = 0; v < g.nodeCount(); ++v)
+        {
+            minX = std::min(minX, g.x(v));
+            minY = std::min(minY, g.y(v));
+            maxX = std::max(maxX, g.x(v));
+            maxY = std::max(maxY, g.y(v));
+        }
+        columns = static_cast<std::size_t>((maxX - minX) / cell) + 1;
+        rows = static_cast<std::size_t>((maxY - minY) / cell) + 1;
+        firstInCell.assign(columns * rows + 1, 0);
+        for(NodeId v = 0; v < g.nodeCount(); ++v)
+        {
+            ++firstInCell[cellOf(g.x(v), g.y(v)) + 1];
+        }
+        for(std::size_t c = 0; c < columns * rows; ++c)
+        {
+            firstInCell[c + 1] += firstInCell[c];
+        }
+        nodes.resize(g.nodeCount());
+        std::vector<std::uint32_t> next(firstInCell.begin(), firstInCell.end() - 1);
+        for(NodeId v = 0; v < g.nodeCount(); ++v)
+        {
+            nodes[next[cellOf(g.x(v), g.y(v))]++] = v;
+        }
+    }
+
+    // Searches rings of cells outward until no closer node can exist.
+    NodeId nearest(float x, float y) const
+    {
+        if(!graph || graph->nodeCount() == 0)
+        {
+            return noNode;
+        }
+        std::size_t home = cellOf(x, y);
+        long cx = static_cast<long>(home % columns), cy = static_cast<long>(home / columns);
+        NodeId best = noNode;
+        double bestDistance = std::numeric_limits<double>::max();
+        for(long ring = 0; ring <= static_cast<long>(std::max(columns, rows)); ++ring)
+        {
+            for(long gy = cy - ring; gy <= cy + ring; ++gy)
+            {
+                for(long gx = cx - ring; gx <= cx + ring; ++gx)
+                {
+                    bool onRing = gy == cy - ring || gy == cy + ring || gx == cx - ring || gx == cx + ring;
+                    if(!onRing || gx < 0 || gy < 0 || gx >= static_cast<long>(columns) || gy >= static_cast<long>(rows))
+                    {
+                        continue;
+                    }
+                    std::size_t c = static_cast<std::size_t>(gy) * columns + static_cast<std::size_t>(gx);
+                    for(std::uint32_t i = firstInCell[c]; i < firstInCell[c + 1]; ++i)
+                    {
+                        double dx = double(graph->x(nodes[i])) - x, dy = double(graph->y(nodes[i])) - y;
+                        double d = dx * dx + dy * dy;
+                        if(d < bestDistance)
+                        {
+                            bestDistance = d;
+                            best = nodes[i];
+                        }
+                    }
+                }
+            }
+            // every unvisited cell is at least ring * cell away
+            double reach = ring * double(cell);
+            if(best != noNode && bestDistance <= reach * reach)
+            {
+                break;
+            }
+        }
+        return best;
+    }
+};
+
+// Concurrent LRU cache of routes keyed by mode and endpoint nodes. Shards have
+// their own lock, list and tile index; every route remembers the tiles its path
+// crosses so invalidating a tile drops exactly the routes through it. Routes are
+// inserted with the generation() read before they were computed, and an insert
+// older than the last invalidation of one of its tiles is refused, so a route
+// built on weights that changed meanwhile never outlives the change.
+class RouteCache
+{
+public :
+    struct Key
+    {
+        TravelMode mode;
+        NodeId from, to;
+        bool operator==(const Key& o) const { return mode == o.mode && from == o.from && to == o.to; }
+    };
+
+private :
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& k) const
+        {
+            std::uint64_t h = (std::uint64_t(k.from) << 32 | k.to) * 0x9E3779B97F4A7C15ULL;
+            return static_cast<std::size_t>(h ^ (h >> 29) ^ static_cast<std::uint64_t>(k.mode));
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        Route route;
+        std::vector<TileId> tiles;
+    };
+
+    struct Shard
+    {
+        std::mutex mtx;
+        std::list<Entry> lru;  // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        std::unordered_map<TileId, std::unordered_set<Key, KeyHash>> byTile;
+        std::unordered_map<TileId, std::uint64_t> invalidatedAt;
+        std::uint64_t clearedAt = 0;
+
+        void erase(std::list<Entry>::iterator it)
+        {
+            for(TileId t : it->tiles)
+            {
+                auto tile = byTile.find(t);
+                tile->second.erase(it->key);
+                if(tile->second.empty())
+                {
+                    byTile.erase(tile);
+                }
+            }
+            index.erase(it->key);
+            lru.erase(it);
+        }
+    };
+
+    static constexpr std::size_t shardCount = 16;
+    std::unique_ptr<Shard[]> shards;
+    std::size_t capacityPerShard;
+    std::atomic<std::uint64_t> hitCount{0}, missCount{0};
+    std::atomic<std::uint64_t> generationCount{0};
+
+    Shard& shardOf(const Key& k) { return shards[KeyHash()(k) % shardCount]; }
+
+public :
+    explicit RouteCache(std::size_t capacity) : shards(new Shard[shardCount]), capacityPerShard(std::max<std::size_t>(1, capacity / shardCount)) {}
+
+    bool lookup(const Key& k, Route& route)
+    {
+        Shard& shard = shardOf(k);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.index.find(k);
+        if(it == shard.index.end())
+        {
+            missCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        hitCount.fetch_add(1, std::memory_order_relaxed);
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        route = it->second->route;
+        return true;
+    }
+
+    // Read before computing a route that will be inserted.
+    std::uint64_t generation() const { return generationCount.load(); }
+
+    // False, and nothing cached, when a tile of the route was invalidated after `stamp`.
+    bool insert(const Key& k, const Route& route, const RoadGraph& graph, std::uint64_t stamp)
+    {
+        std::vector<TileId> tiles;
+        for(NodeId v : route.path)
+        {
+            tiles.push_back(tileAt(graph.x(v), graph.y(v)));
+        }
+        std::sort(tiles.begin(), tiles.end());
+        tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+
+        Shard& shard = shardOf(k);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if(stamp < shard.clearedAt)
+        {
+            return false;
+        }
+        for(TileId t : tiles)
+        {
+            auto at = shard.invalidatedAt.find(t);
+            if(at != shard.invalidatedAt.end() && stamp < at->second)
+            {
+                return false;
+            }
+        }
+        auto existing = shard.index.find(k);
+        if(existing != shard.index.end())
+        {
+            shard.erase(existing->second);
+        }
+        if(shard.lru.size() >= capacityPerShard)
+        {
+            shard.erase(std::prev(shard.lru.end()));
+        }
+        shard.lru.push_front({k, route, std::move(tiles)});
+        shard.index[k] = shard.lru.begin();
+        for(TileId t : shard.lru.front().tiles)
+        {
+            shard.byTile[t].insert(k);
+        }
+        return true;
+    }
+
+    // Drops every cached route that crosses the tile; returns how many.
+    std::size_t invalidateTile(TileId tile)
+    {
+        std::size_t dropped = 0;
+        std::uint64_t stamp = ++generationCount;
+        for(std::size_t s = 0; s < shardCount; ++s)
+        {
+            Shard& shard = shards[s];
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            shard.invalidatedAt[tile] = stamp;
+            auto it = shard.byTile.find(tile);
+            if(it == shard.byTile.end())
+            {
+                continue;
+            }
+            std::vector<Key> keys(it->second.begin(), it->second.end());
+            for(const Key& k : keys)
+            {
+                shard.erase(shard.index[k]);
+                ++dropped;
+            }
+        }
+        return dropped;
+    }
+
+    void clear()
+    {
+        std::uint64_t stamp = ++generationCount;
+        for(std::size_t s = 0; s < shardCount; ++s)
+        {
+            std::lock_guard<std::mutex> lock(shards[s].mtx);
+            shards[s].lru.clear();
+            shards[s].index.clear();
+            shards[s].byTile.clear();
+            shards[s].invalidatedAt.clear();
+            shards[s].clearedAt = stamp;
+        }
+    }
+
+    std::uint64_t hits() const { return hitCount.load(); }
+    std::uint64_t misses() const { return missCount.load(); }
+
+    std::size_t size()
+    {
+        std::size_t total = 0;
+        for(std::size_t s = 0; s < shardCount; ++s)
+        {
+            std::lock_guard<std::mutex> lock(shards[s].mtx);
+            total += shards[s].lru.size();
+        }
+        return total;
+    }
+};
+
+// Bulk query files. Text : one "mode,origin,destination" per line, mode 1-3 as
+// in the menu. Binary : a QueryFileHeader, then `count` QueryRecords. Results
+// come back in input order, as "mode,origin,destination,cost" lines ("-" when
+// unreachable) or as a header with the result magic followed by one cost each.
+struct QueryRecord
+{
+    std::uint32_t mode;   // 1 car, 2 bike, 3 walk
+    NodeId origin;
+    NodeId destination;
+};
+
+struct QueryFileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t count;
+};
+constexpr char queryMagic[8] = {'R', 'O', 'U', 'T', 'E', 'Q', 'R', 'Y'};
+constexpr char resultMagic[8] = {'R', 'O', 'U', 'T', 'E', 'R', 'E', 'S'};
+constexpr std::uint32_t queryVersion = 1;
+
+inline bool isTextPath(const std::string& path)
+{
+    auto endsWith = [&path](const char* suffix)
+    {
+        std::size_t n = std::char_traits<char>::length(suffix);
+        return path.size() >= n && path.compare(path.size() - n, n, suffix) == 0;
+    };
+    return endsWith(".csv") || endsWith(".txt");
+}
+
+// Hands out queries a block at a time, from a mapped binary file or from a
+// text file read through one fixed buffer. Lines that do not parse are skipped.
+class QueryReader
+{
+    MappedFile mapped;
+    const QueryRecord* records = nullptr;
+    std::size_t total = 0, position = 0;
+
+    std::ifstream text;
+    std::vector<char> buffer;
+    std::size_t begin = 0, end = 0;
+    bool binary = false;
+    std::size_t malformed = 0;
+
+    static constexpr std::size_t bufferSize = 1 << 20;
+
+    bool parseLine(const char* first, const char* last, QueryRecord& q)
+    {
+        if(last > first && last[-1] == '\r')
+        {
+            --last;
+        }
+        std::uint32_t* fields[3] = {&q.mode, &q.origin, &q.destination};
+        for(int f = 0; f < 3; ++f)
+        {
+            while(first < last && *first == ' ')
+            {
+                ++first;
+            }
+            std::from_chars_result r = std::from_chars(first, last, *fields[f]);
+            if(r.ec != std::errc())
+            {
+                return false;
+            }
+            first = r.ptr;
+            if(f < 2)
+            {
+                if(first == last || *first != ',')
+                {
+                    return false;
+                }
+                ++first;
+            }
+        }
+        return true;
+    }
+
+public :
+    bool open(const std::string& path)
+    {
+        std::ifstream probe(path, std::ios::binary);
+        char magic[8] = {};
+        probe.read(magic, 8);
+        binary = probe && std::equal(queryMagic, queryMagic + 8, magic);
+        if(binary)
+        {
+            if(!mapped.open(path) || mapped.size() < sizeof(QueryFileHeader))
+            {
+                return false;
+            }
+            const QueryFileHeader* header = reinterpret_cast<const QueryFileHeader*>(mapped.data());
+            if(header->version != queryVersion || header->recordSize != sizeof(QueryRecord) ||
+               header->count > (mapped.size() - sizeof(QueryFileHeader)) / sizeof(QueryRecord))
+            {
+                return false;
+            }
+            records = reinterpret_cast<const QueryRecord*>(mapped.data() + sizeof(QueryFileHeader));
+            total = static_cast<std::size_t>(header->count);
+            return true;
+        }
+        text.open(path, std::ios::binary);
+        buffer.resize(bufferSize);
+        return static_cast<bool>(text);
+    }
+
+    bool isBinary() const { return binary; }
+    std::size_t malformedLines() const { return malformed; }
+
+    std::size_t next(QueryRecord* out, std::size_t max)
+    {
+        if(binary)
+        {
+            std::size_t n = std::min(max, total - position);
+            std::copy(records + position, records + position + n, out);
+            position += n;
+            return n;
+        }
+        std::size_t n = 0;
+        while(n < max)
+        {
+            const char* first = buffer.data() + begin;
+            const char* newline = static_cast<const char*>(std::memchr(first, '\n', end - begin));
+            if(!newline)
+            {
+                // refill : keep the partial line, append what the file has left
+                std::copy(buffer.begin() + static_cast<std::ptrdiff_t>(begin), buffer.begin() + static_cast<std::ptrdiff_t>(end), buffer.begin());
+                end -= begin;
+                begin = 0;
+                if(!text)
+                {
+                    if(end > 0)
+                    {
+                        malformed += parseLine(buffer.data(), buffer.data() + end, out[n]) ? (++n, 0) : 1;
+                        end = 0;
+                    }
+                    break;
+                }
+                if(end == buffer.size())
+                {
+                    buffer.resize(buffer.size() * 2);  // a line longer than the buffer
+                }
+                text.read(buffer.data() + end, static_cast<std::streamsize>(buffer.size() - end));
+                end += static_cast<std::size_t>(text.gcount());
+                continue;
+            }
+            if(newline > first && parseLine(first, newline, out[n]))
+            {
+                ++n;
+            }
+            else if(newline > first && *first != 'm')  // a "mode,origin,..." header is fine
+            {
+                ++malformed;
+            }
+            begin = static_cast<std::size_t>(newline - buffer.data()) + 1;
+        }
+        return n;
+    }
+};
+
+// Writes results as they are solved, through one reused text buffer; a binary
+// result file gets its count patched in when it is closed.
+class ResultWriter
+{
+    std::ofstream out;
+    bool binary = false;
+    std::uint64_t count = 0;
+    std::vector<char> text;
+
+public :
+    bool open(const std::string& path)
+    {
+        binary = !isTextPath(path);
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if(binary)
+        {
+            QueryFileHeader header = {};
+            std::copy(resultMagic, resultMagic + 8, header.magic);
+            header.version = queryVersion;
+            header.recordSize = sizeof(std::uint32_t);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+        return static_cast<bool>(out);
+    }
+
+    void write(const QueryRecord* queries, const std::uint32_t* costs, std::size_t n)
+    {
+        count += n;
+        if(binary)
+        {
+            out.write(reinterpret_cast<const char*>(costs), static_cast<std::streamsize>(n * sizeof(std::uint32_t)));
+            return;
+        }
+        text.resize(n * 48);
+        char* p = text.data();
+        char* last = text.data() + text.size();
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            p = std::to_chars(p, last, queries[i].mode).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, last, queries[i].origin).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, last, queries[i].destination).ptr;
+            *p++ = ',';
+            if(costs[i] == unreachable)
+            {
+                *p++ = '-';
+            }
+            else
+            {
+                p = std::to_chars(p, last, costs[i]).ptr;
+            }
+            *p++ = '\n';
+        }
+        out.write(text.data(), p - text.data());
+    }
+
+    bool close()
+    {
+        if(binary)
+        {
+            out.seekp(static_cast<std::streamoff>(offsetof(QueryFileHeader, count)));
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        }
+        out.close();
+        return !out.fail();
+    }
+};
 
 // STEP1 : Stratergy interface
 class RouteStratergy
 {
 public :
-    virtual void buildRoute() = 0;
+    virtual TravelMode mode() const = 0;
+    virtual const char* description() const = 0;
     virtual ~RouteStratergy() = default;
+
+    virtual Route buildRoute(const RoadGraph& graph, NodeId from, NodeId to, SearchState& state) const
+    {
+        return aStar(graph, mode(), from, to, state);
+    }
+
+    // Cost only, for bulk queries : allocates nothing once `state` is warm.
+    virtual std::uint32_t routeCost(const RoadGraph& graph, NodeId from, NodeId to, SearchState& state) const
+    {
+        return aStarCost(graph, mode(), from, to, state);
+    }
+
+    virtual void buildMatrix(const RoadGraph& graph, const std::vector<NodeId>& sources, const std::vector<NodeId>& targets,
+                             ThreadPool& pool, DistanceMatrix& matrix) const
+    {
+        manyToManyDijkstra(graph, mode(), sources, targets, pool, matrix);
+    }
+
+    // Steady travel speed for reachability queries, 0 when the mode has none.
+    virtual double metersPerMinute() const { return 0.0; }
+
+    virtual Isochrone reachable(const RoadGraph& graph, NodeId from, double minutes, SearchState& state) const
+    {
+        return isochrone(graph, mode(), from, static_cast<std::uint32_t>(minutes * metersPerMinute()), state);
+    }
 };
 
 // STEP2 : Concrete Stratergy
 class CarRoute : public RouteStratergy
 {
+    std::shared_ptr<const ContractionHierarchy> hierarchy;
+    std::shared_ptr<const LiveTraffic> traffic;
 public :
-    void buildRoute() override 
+    CarRoute() = default;
+    // Queries go through the hierarchy, which must be built from the same graph.
+    explicit CarRoute(std::shared_ptr<const ContractionHierarchy> ch) : hierarchy(std::move(ch)) {}
+    // Queries use the latest customized traffic weights.
+    explicit CarRoute(std::shared_ptr<const LiveTraffic> live) : traffic(std::move(live)) {}
+
+    TravelMode mode() const override { return TravelMode::Car; }
+    const char* description() const override { return "building faster route for car"; }
+
+    Route buildRoute(const RoadGraph& graph, NodeId from, NodeId to, SearchState& state) const override
+    {
+        if(traffic)
+        {
+            std::shared_ptr<const CustomizableHierarchy::Metric> metric = traffic->current();
+            return traffic->topology().query(from, to, *metric, state, state.backward());
+        }
+        if(hierarchy)
+        {
+            return hierarchy->query(from, to, state, state.backward());
+        }
+        return aStar(graph, mode(), from, to, state);
+    }
+
+    std::uint32_t routeCost(const RoadGraph& graph, NodeId from, NodeId to, SearchState& state) const override
+    {
+        if(traffic)
+        {
+            std::shared_ptr<const CustomizableHierarchy::Metric> metric = traffic->current();
+            std::uint32_t meet;
+            return traffic->topology().queryCost(from, to, *metric, state, state.backward(), meet);
+        }
+        if(hierarchy)
+        {
+            NodeId meet;
+            return hierarchy->queryCost(from, to, state, state.backward(), meet);
+        }
+        return aStarCost(graph, mode(), from, to, state);
+    }
+
+    void buildMatrix(const RoadGraph& graph, const std::vector<NodeId>& sources, const std::vector<NodeId>& targets,
+                     ThreadPool& pool, DistanceMatrix& matrix) const override
     {
-        std::cout<<"building faster route for car"<<std::endl;
+        if(traffic)
+        {
+            std::shared_ptr<const CustomizableHierarchy::Metric> metric = traffic->current();
+            traffic->topology().manyToMany(sources, targets, *metric, pool, matrix);
+            return;
+        }
+        if(hierarchy)
+        {
+            hierarchy->manyToMany(sources, targets, pool, matrix);
+            return;
+        }
+        manyToManyDijkstra(graph, mode(), sources, targets, pool, matrix);
     }
 };
 
 class BikeRoute : public RouteStratergy
 {
 public :
-    void buildRoute() override 
-    {
-        std::cout<<"building shortest route for bike"<<std::endl;
-    }
+    TravelMode mode() const override { return TravelMode::Bike; }
+    const char* description() const override { return "building shortest route for bike"; }
+    double metersPerMinute() const override { return 250.0; }  // 15 km/h
 };
 
-class WalkRoute : public RouteStratergy 
+class WalkRoute : public RouteStratergy
 {
 public :
-    void buildRoute() override 
-    {
-        std::cout<<"building sceneric route for walk"<<std::endl;
-    }
+    TravelMode mode() const override { return TravelMode::Walk; }
+    const char* description() const override { return "building sceneric route for walk"; }
+    double metersPerMinute() const override { return 80.0; }   // 4.8 km/h
 };
 
 // STEP 3 : CONTEXt
-class Navigator 
+class Navigator
 {
     std::unique_ptr<RouteStratergy> routeStratergy;
+    std::shared_ptr<const RoadGraph> graph;
+    SearchState state;
+    RouteCache* cache = nullptr;
+    NodeLocator locator;
 public :
     void setRouteStragergy(std::unique_ptr<RouteStratergy> s)
     {
         routeStratergy = std::move(s);
     }
 
-    void navigate()
+    void setGraph(std::shared_ptr<const RoadGraph> g)
+    {
+        graph = std::move(g);
+        locator.build(*graph);
+        if(cache)
+        {
+            cache->clear();
+        }
+    }
+
+    // Shared by every Navigator routing on the same graph.
+    void setRouteCache(RouteCache* c)
+    {
+        cache = c;
+    }
+
+    Route navigate(NodeId from, NodeId to)
+    {
+        if(!routeStratergy || !graph)
+        {
+            std::cout<<"routeStratergy or graph is not set"<<std::endl;
+            return Route();
+        }
+        RouteCache::Key key = {routeStratergy->mode(), from, to};
+        Route route;
+        if(cache && cache->lookup(key, route))
+        {
+            return route;
+        }
+        std::uint64_t stamp = cache ? cache->generation() : 0;
+        route = routeStratergy->buildRoute(*graph, from, to, state);
+        if(cache && !route.path.empty())
+        {
+            cache->insert(key, route, *graph, stamp);
+        }
+        return route;
+    }
+
+    // Routes between the nodes nearest to two map points, so nearby requests share cache entries.
+    Route navigate(float fromX, float fromY, float toX, float toY)
+    {
+        return navigate(locator.nearest(fromX, fromY), locator.nearest(toX, toY));
+    }
+
+    const char* description() const { return routeStratergy->description(); }
+
+    // Area reachable within `minutes` in the current mode (walk and bike only).
+    Isochrone isochrone(NodeId from, double minutes)
+    {
+        if(!routeStratergy || !graph)
+        {
+            std::cout<<"routeStratergy or graph is not set"<<std::endl;
+            return Isochrone();
+        }
+        if(routeStratergy->metersPerMinute() <= 0.0)
+        {
+            std::cout<<"reachability is only available for walk and bike"<<std::endl;
+            return Isochrone();
+        }
+        return routeStratergy->reachable(*graph, from, minutes, state);
+    }
+
+    // New car weights for every graph arc. Cached routes through a tile with a
+    // changed arc are dropped and counted in `dropped`; false if the traffic
+    // model rejected the update, in which case nothing changes.
+    bool applyTraffic(LiveTraffic& traffic, std::vector<std::uint32_t> weights, ThreadPool& pool, std::size_t& dropped)
     {
-        if(routeStratergy)
+        dropped = 0;
+        std::vector<ArcId> changed;
+        if(!traffic.update(std::move(weights), pool, changed))
+        {
+            std::cout<<"traffic update rejected : one weight per arc is needed and closed roads cannot reopen"<<std::endl;
+            return false;
+        }
+        if(!cache || !graph || changed.empty())
+        {
+            return true;
+        }
+        std::vector<std::uint8_t> isChanged(graph->arcCount(), 0);
+        for(ArcId a : changed)
+        {
+            isChanged[a] = 1;
+        }
+        std::vector<TileId> tiles;
+        for(NodeId u = 0; u < graph->nodeCount(); ++u)
+        {
+            for(ArcId a = graph->firstOut(u); a < graph->firstOut(u + 1); ++a)
+            {
+                if(isChanged[a])
+                {
+                    tiles.push_back(tileAt(graph->x(u), graph->y(u)));
+                    tiles.push_back(tileAt(graph->x(graph->head(a)), graph->y(graph->head(a))));
+                }
+            }
+        }
+        std::sort(tiles.begin(), tiles.end());
+        tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+        for(TileId t : tiles)
         {
-            routeStratergy->buildRoute();
+            dropped += cache->invalidateTile(t);
         }
-        else 
+        return true;
+    }
+
+    // Cost from every source to every target in the current mode.
+    DistanceMatrix matrix(const std::vector<NodeId>& sources, const std::vector<NodeId>& targets, ThreadPool& pool)
+    {
+        DistanceMatrix result;
+        if(!routeStratergy || !graph)
         {
-            std::cout<<"routeStratergy is not set"<<std::endl;
+            std::cout<<"routeStratergy or graph is not set"<<std::endl;
+            return result;
         }
+        routeStratergy->buildMatrix(*graph, sources, targets, pool, result);
+        return result;
     }
+
+    TravelMode mode() const { return routeStratergy->mode(); }
 };
 
-int main()
+// "grid:WxH" builds a synthetic city and "uniform:WxH" a grid of identical
+// streets; otherwise a binary graph file is mapped and anything else is
+// parsed as the text format.
+std::shared_ptr<RoadGraph> loadGraph(const std::string& spec)
+{
+    auto graph = std::make_shared<RoadGraph>();
+    unsigned width = 0, height = 0;
+    if(std::sscanf(spec.c_str(), "grid:%ux%u", &width, &height) == 2)
+    {
+        graph->makeGrid(width, height);
+    }
+    else if(std::sscanf(spec.c_str(), "uniform:%ux%u", &width, &height) == 2)
+    {
+        graph->makeUniformGrid(width, height);
+    }
+    else if(RoadGraph::isBinaryFile(spec) ? !graph->open(spec) : !graph->load(spec))
+    {
+        std::cout<<"cannot load graph "<<spec<<std::endl;
+        return nullptr;
+    }
+    std::cout<<"graph : "<<graph->nodeCount()<<" nodes, "<<graph->arcCount()<<" arcs"<<std::endl;
+    return graph;
+}
+
+// Offline step : contract the car network and write the hierarchy for CarRoute.
+int runBuildCh(const std::string& graphSpec, const std::string& outPath, unsigned threads)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    ThreadPool pool(threads);
+    ContractionHierarchy ch;
+    auto start = std::chrono::steady_clock::now();
+    ch.build(*graph, pool);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(!ch.save(outPath, *graph))
+    {
+        std::cout<<"cannot write "<<outPath<<std::endl;
+        return 1;
+    }
+    std::cout<<"hierarchy : "<<ch.arcCount()<<" upward arcs, built in "<<seconds<<" s on "<<threads<<" threads"<<std::endl;
+    return 0;
+}
+
+// Builds a hierarchy and compares its car costs with A* on random queries;
+// exits non-zero on any difference.
+int runCheckCh(const std::string& graphSpec, std::size_t queries, unsigned threads)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph || graph->nodeCount() == 0)
+    {
+        return 1;
+    }
+    ThreadPool pool(threads);
+    ContractionHierarchy ch;
+    ch.build(*graph, pool);
+
+    SearchState state;
+    std::uint64_t seed = 7;
+    std::size_t longer = 0, shorter = 0;
+    for(std::size_t q = 0; q < queries; ++q)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        NodeId from = static_cast<NodeId>((seed >> 33) % graph->nodeCount());
+        NodeId to = static_cast<NodeId>((seed >> 13) % graph->nodeCount());
+        std::uint32_t expected = aStarCost(*graph, TravelMode::Car, from, to, state);
+        NodeId meet;
+        std::uint32_t got = ch.queryCost(from, to, state, state.backward(), meet);
+        longer += got > expected;
+        shorter += got < expected;
+    }
+    std::cout<<queries<<" car queries : "<<longer<<" longer and "<<shorter<<" shorter than A*"<<std::endl;
+    return longer + shorter == 0 ? 0 : 1;
+}
+
+// Text or synthetic graph to the mapped binary format.
+int runConvert(const std::string& graphSpec, const std::string& outPath)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    if(!graph->save(outPath))
+    {
+        std::cout<<"cannot write "<<outPath<<std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Random depots x stops table in the chosen mode.
+int runMatrix(const std::string& graphSpec, int modeChoice, std::size_t rows, std::size_t cols, const std::string& chPath, unsigned threads)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    Navigator mapApp;
+    mapApp.setGraph(graph);
+    std::shared_ptr<ContractionHierarchy> hierarchy;
+    if(!chPath.empty())
+    {
+        hierarchy = std::make_shared<ContractionHierarchy>();
+        if(!hierarchy->load(chPath, *graph))
+        {
+            std::cout<<"hierarchy "<<chPath<<" does not match the graph"<<std::endl;
+            return 1;
+        }
+    }
+    switch(modeChoice)
+    {
+        case 1 : mapApp.setRouteStragergy(std::make_unique<CarRoute>(hierarchy)); break;
+        case 2 : mapApp.setRouteStragergy(std::make_unique<BikeRoute>()); break;
+        default : mapApp.setRouteStragergy(std::make_unique<WalkRoute>()); break;
+    }
+
+    std::uint64_t seed = 12345;
+    auto pick = [&seed, &graph]
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<NodeId>((seed >> 33) % graph->nodeCount());
+    };
+    std::vector<NodeId> sources(rows), targets(cols);
+    std::generate(sources.begin(), sources.end(), pick);
+    std::generate(targets.begin(), targets.end(), pick);
+
+    ThreadPool pool(threads);
+    auto start = std::chrono::steady_clock::now();
+    DistanceMatrix m = mapApp.matrix(sources, targets, pool);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(std::size_t r = 0; r < std::min<std::size_t>(3, m.rows); ++r)
+    {
+        for(std::size_t c = 0; c < std::min<std::size_t>(3, m.cols); ++c)
+        {
+            std::cout<<m.at(r, c)<<" ";
+        }
+        std::cout<<"..."<<std::endl;
+    }
+    std::cout<<rows<<" x "<<cols<<" "<<costUnit(mapApp.mode())<<" matrix in "<<seconds * 1000<<" ms on "<<threads<<" threads"<<std::endl;
+    return 0;
+}
+
+// Replays point-to-point requests where most pairs repeat, then a traffic update on one tile.
+int runCacheDemo(const std::string& graphSpec, std::size_t queries, std::size_t distinctPairs)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    RouteCache cache(distinctPairs);
+    Navigator mapApp;
+    mapApp.setGraph(graph);
+    mapApp.setRouteCache(&cache);
+    mapApp.setRouteStragergy(std::make_unique<BikeRoute>());
+
+    std::uint64_t seed = 99;
+    auto random = [&seed](std::uint64_t bound)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (seed >> 33) % bound;
+    };
+    std::vector<std::pair<NodeId, NodeId>> pairs(distinctPairs);
+    for(auto& p : pairs)
+    {
+        p = {static_cast<NodeId>(random(graph->nodeCount())), static_cast<NodeId>(random(graph->nodeCount()))};
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t checksum = 0;
+    for(std::size_t q = 0; q < queries; ++q)
+    {
+        // a skewed pick : low pair indices are asked far more often
+        std::size_t i = static_cast<std::size_t>(random(distinctPairs) * random(distinctPairs) / distinctPairs);
+        Route r = mapApp.navigate(pairs[i].first, pairs[i].second);
+        checksum += r.cost;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout<<queries<<" queries in "<<seconds * 1000<<" ms ("<<seconds * 1e6 / queries<<" us each), "
+             <<cache.hits()<<" hits, "<<cache.misses()<<" misses, "<<cache.size()<<" routes cached, checksum "<<checksum<<std::endl;
+
+    NodeId middle = static_cast<NodeId>(graph->nodeCount() / 2);
+    TileId tile = tileAt(graph->x(middle), graph->y(middle));
+    std::size_t before = cache.size();
+    std::size_t dropped = cache.invalidateTile(tile);
+    std::cout<<"traffic update on the centre tile dropped "<<dropped<<" of "<<before<<" routes"<<std::endl;
+    return 0;
+}
+
+// Live traffic : the topology is prepared once, then every round congests a
+// few tiles, customizes the new weights and swaps them in while a second
+// thread keeps answering car queries from whichever snapshot is current.
+int runTrafficDemo(const std::string& graphSpec, std::size_t rounds, unsigned threads)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    ThreadPool pool(threads);
+    auto start = std::chrono::steady_clock::now();
+    auto cch = std::make_shared<CustomizableHierarchy>();
+    cch->build(*graph);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout<<"topology : "<<cch->arcCount()<<" upward arcs, "<<cch->levelCount()<<" levels, prepared in "<<seconds * 1000<<" ms"<<std::endl;
+
+    start = std::chrono::steady_clock::now();
+    auto traffic = std::make_shared<LiveTraffic>(cch, *graph, pool);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout<<"free flow weights customized in "<<seconds * 1000<<" ms"<<std::endl;
+
+    RouteCache cache(4096);
+    Navigator mapApp;
+    mapApp.setGraph(graph);
+    mapApp.setRouteCache(&cache);
+    mapApp.setRouteStragergy(std::make_unique<CarRoute>(std::shared_ptr<const LiveTraffic>(traffic)));
+
+    std::uint64_t seed = 2024;
+    auto random = [&seed](std::uint64_t bound)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (seed >> 33) % bound;
+    };
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> served{0};
+    std::thread reader([&]
+    {
+        CarRoute car{std::shared_ptr<const LiveTraffic>(traffic)};
+        SearchState state;
+        std::uint64_t s = 7;
+        while(!stop.load())
+        {
+            s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+            NodeId from = static_cast<NodeId>((s >> 33) % graph->nodeCount());
+            NodeId to = static_cast<NodeId>((s >> 13) % graph->nodeCount());
+            car.buildRoute(*graph, from, to, state);
+            served.fetch_add(1);
+        }
+    });
+
+    const std::uint32_t* freeFlow = graph->weights(TravelMode::Car);
+    for(std::size_t round = 1; round <= rounds; ++round)
+    {
+        for(int q = 0; q < 200; ++q)
+        {
+            mapApp.navigate(static_cast<NodeId>(random(graph->nodeCount())), static_cast<NodeId>(random(graph->nodeCount())));
+        }
+        std::vector<TileId> congested(4);
+        for(TileId& t : congested)
+        {
+            NodeId v = static_cast<NodeId>(random(graph->nodeCount()));
+            t = tileAt(graph->x(v), graph->y(v));
+        }
+        std::vector<std::uint32_t> weights(freeFlow, freeFlow + graph->arcCount());
+        for(NodeId u = 0; u < graph->nodeCount(); ++u)
+        {
+            if(std::find(congested.begin(), congested.end(), tileAt(graph->x(u), graph->y(u))) == congested.end())
+            {
+                continue;
+            }
+            for(ArcId a = graph->firstOut(u); a < graph->firstOut(u + 1); ++a)
+            {
+                if(weights[a] != blocked)
+                {
+                    weights[a] *= 3;
+                }
+            }
+        }
+
+        std::size_t cachedBefore = cache.size();
+        std::uint64_t servedBefore = served.load();
+        start = std::chrono::steady_clock::now();
+        std::size_t dropped = 0;
+        if(!mapApp.applyTraffic(*traffic, std::move(weights), pool, dropped))
+        {
+            break;
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout<<"round "<<round<<" : customized in "<<seconds * 1000<<" ms, "<<served.load() - servedBefore
+                 <<" queries answered meanwhile, "<<dropped<<" of "<<cachedBefore<<" cached routes dropped"<<std::endl;
+    }
+    stop = true;
+    reader.join();
+    return 0;
+}
+
+// Random queries, mostly car, for trying out the batch mode.
+int runMakeQueries(const std::string& graphSpec, std::size_t count, const std::string& outPath)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    bool text = isTextPath(outPath);
+    if(text)
+    {
+        out<<"mode,origin,destination\n";
+    }
+    else
+    {
+        QueryFileHeader header = {};
+        std::copy(queryMagic, queryMagic + 8, header.magic);
+        header.version = queryVersion;
+        header.recordSize = sizeof(QueryRecord);
+        header.count = count;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    std::uint64_t seed = 31;
+    auto random = [&seed](std::uint64_t bound)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<std::uint32_t>((seed >> 33) % bound);
+    };
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        std::uint32_t pick = random(10);
+        QueryRecord q = {pick < 6 ? 1u : pick < 8 ? 2u : 3u, random(graph->nodeCount()), random(graph->nodeCount())};
+        if(text)
+        {
+            out<<q.mode<<','<<q.origin<<','<<q.destination<<'\n';
+        }
+        else
+        {
+            out.write(reinterpret_cast<const char*>(&q), sizeof(q));
+        }
+    }
+    return out ? 0 : 1;
+}
+
+// Solves a query file in blocks : each pool slot keeps its own SearchState
+// for the whole run and asks the strategies for costs only, so after the first
+// block nothing is allocated per query. Results stream out block by block.
+int runBatch(const std::string& graphSpec, const std::string& queriesPath, const std::string& outPath,
+             const std::string& chPath, unsigned threads)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    std::shared_ptr<ContractionHierarchy> hierarchy;
+    if(!chPath.empty())
+    {
+        hierarchy = std::make_shared<ContractionHierarchy>();
+        if(!hierarchy->load(chPath, *graph))
+        {
+            std::cout<<"hierarchy "<<chPath<<" does not match the graph"<<std::endl;
+            return 1;
+        }
+    }
+    std::unique_ptr<RouteStratergy> strategies[modeCount] = {
+        std::make_unique<CarRoute>(hierarchy), std::make_unique<BikeRoute>(), std::make_unique<WalkRoute>()};
+
+    QueryReader reader;
+    if(!reader.open(queriesPath))
+    {
+        std::cout<<"cannot read queries "<<queriesPath<<std::endl;
+        return 1;
+    }
+    ResultWriter writer;
+    if(!writer.open(outPath))
+    {
+        std::cout<<"cannot write "<<outPath<<std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(threads);
+    std::size_t slots = pool.size();
+    std::vector<SearchState> states(slots);
+    constexpr std::size_t blockSize = 1 << 14;
+    std::vector<QueryRecord> block(blockSize);
+    std::vector<std::uint32_t> costs(blockSize);
+    std::size_t solved = 0;
+    auto start = std::chrono::steady_clock::now();
+    while(std::size_t n = reader.next(block.data(), blockSize))
+    {
+        pool.run(slots, [&](std::size_t slot)
+        {
+            for(std::size_t i = slot; i < n; i += slots)
+            {
+                const QueryRecord& q = block[i];
+                costs[i] = q.mode >= 1 && q.mode <= modeCount
+                    ? strategies[q.mode - 1]->routeCost(*graph, q.origin, q.destination, states[slot])
+                    : unreachable;
+            }
+        });
+        writer.write(block.data(), costs.data(), n);
+        solved += n;
+    }
+    if(!writer.close())
+    {
+        std::cout<<"cannot write "<<outPath<<std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout<<solved<<" queries in "<<seconds<<" s ("<<(seconds > 0 ? solved / seconds : 0.0)<<" per second) on "<<threads<<" threads";
+    if(reader.malformedLines())
+    {
+        std::cout<<", "<<reader.malformedLines()<<" malformed lines skipped";
+    }
+    std::cout<<std::endl;
+    return 0;
+}
+
+// Area reachable from one node, with the boundary polygon and its area.
+int runIsochrone(const std::string& graphSpec, int modeChoice, NodeId origin, double minutes)
+{
+    std::shared_ptr<RoadGraph> graph = loadGraph(graphSpec);
+    if(!graph)
+    {
+        return 1;
+    }
+    Navigator mapApp;
+    mapApp.setGraph(graph);
+    switch(modeChoice)
+    {
+        case 2 : mapApp.setRouteStragergy(std::make_unique<BikeRoute>()); break;
+        case 3 : mapApp.setRouteStragergy(std::make_unique<WalkRoute>()); break;
+        default : mapApp.setRouteStragergy(std::make_unique<CarRoute>()); break;
+    }
+
+    Isochrone area;
+    double ms = 0;
+    for(int run = 0; run < 2; ++run)  // the second run reuses warm search state
+    {
+        auto start = std::chrono::steady_clock::now();
+        area = mapApp.isochrone(origin, minutes);
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    double squareMeters = 0;
+    for(std::size_t i = 0; i < area.boundary.size(); ++i)
+    {
+        const Point& a = area.boundary[i];
+        const Point& b = area.boundary[(i + 1) % area.boundary.size()];
+        squareMeters += (double(a.x) * b.y - double(b.x) * a.y) / 2;
+    }
+    std::cout<<area.nodes.size()<<" nodes reachable within "<<minutes<<" min, boundary of "<<area.boundary.size()
+             <<" points enclosing "<<squareMeters / 1e6<<" km2, found in "<<ms<<" ms"<<std::endl;
+    return 0;
+}
+
+// nav [graph] [hierarchy.ch]            interactive route, graph defaults to grid:300x300
+// nav convert <graph> <out.graph>
+// nav build-ch <graph> <out.ch> [threads]
+// nav check-ch <graph> [queries] [threads]   e.g. check-ch uniform:70x70
+// nav matrix <graph> <mode 1-3> <rows> <cols> [hierarchy.ch|-] [threads]
+// nav cache <graph> [queries] [distinctPairs]
+// nav traffic <graph> [rounds] [threads]
+// nav make-queries <graph> <count> <out.csv|out.bin>
+// nav batch <graph> <queries> <results.csv|results.bin> [hierarchy.ch|-] [threads]
+// nav isochrone <graph> <mode 2-3> <origin> <minutes>
+int main(int argc, char* argv[])
 {
+    if(argc > 5 && std::string(argv[1]) == "isochrone")
+    {
+        return runIsochrone(argv[2], std::stoi(argv[3]), static_cast<NodeId>(std::stoul(argv[4])), std::stod(argv[5]));
+    }
+
+    if(argc > 4 && std::string(argv[1]) == "batch")
+    {
+        std::string chPath = argc > 5 && std::string(argv[5]) != "-" ? argv[5] : "";
+        unsigned threads = argc > 6 ? static_cast<unsigned>(std::stoul(argv[6])) : defaultThreads();
+        return runBatch(argv[2], argv[3], argv[4], chPath, threads);
+    }
+
+    if(argc > 4 && std::string(argv[1]) == "make-queries")
+    {
+        return runMakeQueries(argv[2], std::stoull(argv[3]), argv[4]);
+    }
+
+    if(argc > 2 && std::string(argv[1]) == "traffic")
+    {
+        unsigned threads = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : defaultThreads();
+        return runTrafficDemo(argv[2], argc > 3 ? std::stoull(argv[3]) : 3, threads);
+    }
+
+    if(argc > 2 && std::string(argv[1]) == "cache")
+    {
+        return runCacheDemo(argv[2], argc > 3 ? std::stoull(argv[3]) : 20000, argc > 4 ? std::stoull(argv[4]) : 2000);
+    }
+
+    if(argc > 5 && std::string(argv[1]) == "matrix")
+    {
+        std::string chPath = argc > 6 && std::string(argv[6]) != "-" ? argv[6] : "";
+        unsigned threads = argc > 7 ? static_cast<unsigned>(std::stoul(argv[7])) : defaultThreads();
+        return runMatrix(argv[2], std::stoi(argv[3]), std::stoull(argv[4]), std::stoull(argv[5]), chPath, threads);
+    }
+
+    if(argc > 3 && std::string(argv[1]) == "convert")
+    {
+        return runConvert(argv[2], argv[3]);
+    }
+
+    if(argc > 2 && std::string(argv[1]) == "check-ch")
+    {
+        unsigned threads = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : defaultThreads();
+        return runCheckCh(argv[2], argc > 3 ? std::stoull(argv[3]) : 2000, threads);
+    }
+
+    if(argc > 3 && std::string(argv[1]) == "build-ch")
+    {
+        unsigned threads = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : defaultThreads();
+        return runBuildCh(argv[2], argv[3], threads);
+    }
+
     Navigator mapApp;
 
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<RoadGraph> graph = loadGraph(argc > 1 ? argv[1] : "grid:300x300");
+    if(!graph)
+    {
+        return 1;
+    }
+    std::cout<<"loaded in "<<std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()<<" ms"<<std::endl;
+    mapApp.setGraph(graph);
+
+    std::shared_ptr<ContractionHierarchy> hierarchy;
+    if(argc > 2)
+    {
+        hierarchy = std::make_shared<ContractionHierarchy>();
+        if(!hierarchy->load(argv[2], *graph))
+        {
+            std::cout<<"hierarchy "<<argv[2]<<" does not match the graph, car routes use A*"<<std::endl;
+            hierarchy.reset();
+        }
+    }
+
     int choice;
 
     std::cout<<"Enter RouteMode : \n";
@@ -73,7 +3729,7 @@ int main()
     switch(choice)
     {
         case 1 : {
-            mapApp.setRouteStragergy(std::make_unique<CarRoute>());
+            mapApp.setRouteStragergy(std::make_unique<CarRoute>(hierarchy));
             break;
         }
         case 2 : {
@@ -84,12 +3740,26 @@ int main()
             mapApp.setRouteStragergy(std::make_unique<WalkRoute>());
             break;
         }
-        default : 
+        default :
             std::cout<<"Invalid route "<<std::endl;
             return 0;
     }
 
-    mapApp.navigate();
+    NodeId from, to;
+    std::cout<<"Enter origin and destination node ids : ";
+    std::cin>>from>>to;
+
+    std::cout<<mapApp.description()<<std::endl;
+    start = std::chrono::steady_clock::now();
+    Route route = mapApp.navigate(from, to);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if(route.path.empty())
+    {
+        std::cout<<"no route from "<<from<<" to "<<to<<std::endl;
+        return 0;
+    }
+    std::cout<<"cost "<<route.cost<<" "<<costUnit(mapApp.mode())<<", "<<route.path.size()<<" nodes, found in "<<ms<<" ms"<<std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
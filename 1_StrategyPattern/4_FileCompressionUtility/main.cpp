@@ -1,5 +1,737 @@
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+// CRC-32 as used by zip, eight table lookups per 8 input bytes.
+class Crc32
+{
+    std::uint32_t table[8][256];
+
+    Crc32()
+    {
+        for(std::uint32_t i = 0; i < 256; ++i)
+        {
+            std::uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[0][i] = c;
+        }
+        for(std::uint32_t i = 0; i < 256; ++i)
+        {
+            for(int t = 1; t < 8; ++t)
+            {
+                table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+            }
+        }
+    }
+
+public :
+    static std::uint32_t update(std::uint32_t crc, const std::uint8_t* data, std::size_t n)
+    {
+        static const Crc32 tables;
+        const auto& t = tables.table;
+        crc = ~crc;
+        while(n >= 8)
+        {
+            std::uint32_t lo = crc ^ (std::uint32_t(data[0]) | std::uint32_t(data[1]) << 8 | std::uint32_t(data[2]) << 16 | std::uint32_t(data[3]) << 24);
+            std::uint32_t hi = std::uint32_t(data[4]) | std::uint32_t(data[5]) << 8 | std::uint32_t(data[6]) << 16 | std::uint32_t(data[7]) << 24;
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+            data += 8;
+            n -= 8;
+        }
+        while(n--)
+        {
+            crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+};
+
+// Deflate (RFC 1951) encoder : greedy LZ77 over a 32K sliding window with hash
+// chains, then one Huffman block per window slide or full symbol buffer, each
+// written as dynamic, fixed or stored, whichever is smallest. Input arrives in
+// chunks of any size and output leaves through the sink, so memory stays the
+// same however long the stream is.
+class DeflateEncoder
+{
+public :
+    using Sink = std::function<void(const std::uint8_t*, std::size_t)>;
+
+private :
+    static constexpr std::size_t windowSize = 1 << 15;
+    static constexpr std::size_t windowMask = windowSize - 1;
+    static constexpr std::size_t minMatch = 3;
+    static constexpr std::size_t maxMatch = 258;
+    static constexpr std::size_t minLookahead = maxMatch + minMatch + 1;
+    static constexpr std::size_t tooFar = 4096;   // a length 3 match further back costs more than its literals
+    static constexpr unsigned hashBits = 15;
+    static constexpr std::size_t maxBlockSymbols = 1 << 15;
+    static constexpr std::size_t outputChunk = 1 << 16;
+
+    static constexpr unsigned literalCount = 286;
+    static constexpr unsigned distanceCount = 30;
+    static constexpr unsigned maxCodeBits = 15;
+    static constexpr unsigned maxCodeLengthBits = 7;
+
+    // Symbol tables shared by every encoder.
+    struct Tables
+    {
+        std::uint8_t lengthSymbol[maxMatch + 1];   // match length -> length code - 257
+        std::uint8_t distanceSymbol[512];          // see distanceCode()
+        std::uint16_t fixedLiteralCode[288];
+        std::uint8_t fixedLiteralLength[288];
+        std::uint16_t fixedDistanceCode[distanceCount];
+        std::uint8_t fixedDistanceLength[distanceCount];
+
+        static constexpr std::uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static constexpr std::uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static constexpr std::uint16_t distanceBase[distanceCount] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                                      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                                                      8193, 12289, 16385, 24577};
+        static constexpr std::uint8_t distanceExtra[distanceCount] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                                      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        Tables()
+        {
+            for(std::uint8_t c = 0; c < 29; ++c)
+            {
+                for(std::size_t len = lengthBase[c]; len < lengthBase[c] + (1u << lengthExtra[c]) && len <= maxMatch; ++len)
+                {
+                    lengthSymbol[len] = c;
+                }
+            }
+            lengthSymbol[maxMatch] = 28;
+            for(std::uint8_t c = 0; c < distanceCount; ++c)
+            {
+                for(std::size_t d = distanceBase[c] - 1u; d < distanceBase[c] - 1u + (1u << distanceExtra[c]); ++d)
+                {
+                    distanceSymbol[d < 256 ? d : 256 + (d >> 7)] = c;
+                }
+            }
+            std::uint8_t lengths[288];
+            std::fill(lengths, lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            std::copy(lengths, lengths + 288, fixedLiteralLength);
+            canonicalCodes(fixedLiteralLength, 288, fixedLiteralCode);
+            std::fill(fixedDistanceLength, fixedDistanceLength + distanceCount, 5);
+            canonicalCodes(fixedDistanceLength, distanceCount, fixedDistanceCode);
+        }
+
+        // distances up to 256 look up directly, longer ones by their top bits
+        std::uint8_t distanceCode(std::size_t distance) const
+        {
+            std::size_t d = distance - 1;
+            return distanceSymbol[d < 256 ? d : 256 + (d >> 7)];
+        }
+    };
+
+    static const Tables& tables()
+    {
+        static const Tables t;
+        return t;
+    }
+
+    // Canonical codes for the lengths, bit reversed because deflate writes
+    // Huffman codes starting from their most significant bit.
+    static void canonicalCodes(const std::uint8_t* lengths, std::size_t n, std::uint16_t* codes)
+    {
+        std::uint16_t count[maxCodeBits + 1] = {};
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            ++count[lengths[i]];
+        }
+        count[0] = 0;
+        std::uint16_t next[maxCodeBits + 2] = {};
+        for(unsigned bits = 1; bits <= maxCodeBits; ++bits)
+        {
+            next[bits + 1] = static_cast<std::uint16_t>((next[bits] + count[bits]) << 1);
+        }
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            unsigned len = lengths[i];
+            if(len == 0)
+            {
+                continue;
+            }
+            std::uint16_t code = next[len]++;
+            std::uint16_t reversed = 0;
+            for(unsigned b = 0; b < len; ++b)
+            {
+                reversed = static_cast<std::uint16_t>((reversed << 1) | ((code >> b) & 1));
+            }
+            codes[i] = reversed;
+        }
+    }
+
+    // Huffman code lengths for `freq`, none longer than maxBits. Optimal
+    // lengths come from the two-queue construction over sorted leaves; if the
+    // tree is too deep the length counts are flattened until the Kraft sum is
+    // exact again, and the lengths are handed back out by frequency.
+    static void buildLengths(const std::uint32_t* freq, std::size_t n, unsigned maxBits, std::uint8_t* lengths)
+    {
+        std::fill(lengths, lengths + n, 0);
+        std::vector<std::pair<std::uint32_t, std::uint16_t>> leaves;
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            if(freq[i])
+            {
+                leaves.push_back({freq[i], static_cast<std::uint16_t>(i)});
+            }
+        }
+        // a single code would be incomplete, which inflaters may reject
+        for(std::size_t i = 0; leaves.size() < 2 && i < n; ++i)
+        {
+            if(!freq[i])
+            {
+                leaves.push_back({0, static_cast<std::uint16_t>(i)});
+            }
+        }
+        std::sort(leaves.begin(), leaves.end());
+        std::size_t m = leaves.size();
+
+        // nodes [0, m) are leaves, [m, 2m - 1) internal in creation order
+        std::vector<std::uint64_t> weight(2 * m - 1);
+        std::vector<std::uint32_t> parent(2 * m - 1);
+        for(std::size_t i = 0; i < m; ++i)
+        {
+            weight[i] = leaves[i].first;
+        }
+        std::size_t nextLeaf = 0, nextInner = m, created = m;
+        auto takeSmallest = [&]
+        {
+            if(nextLeaf < m && (nextInner == created || weight[nextLeaf] <= weight[nextInner]))
+            {
+                return nextLeaf++;
+            }
+            return nextInner++;
+        };
+        while(created < 2 * m - 1)
+        {
+            std::size_t a = takeSmallest();
+            std::size_t b = takeSmallest();
+            weight[created] = weight[a] + weight[b];
+            parent[a] = parent[b] = static_cast<std::uint32_t>(created);
+            ++created;
+        }
+        std::vector<std::uint32_t> depth(2 * m - 1, 0);
+        std::uint32_t lengthCount[64] = {};
+        for(std::size_t i = 2 * m - 1; i-- > 0;)
+        {
+            if(i != 2 * m - 2)
+            {
+                depth[i] = depth[parent[i]] + 1;
+            }
+            if(i < m)
+            {
+                ++lengthCount[std::min<std::uint32_t>(depth[i], 63)];
+            }
+        }
+
+        for(unsigned bits = maxBits + 1; bits < 64; ++bits)
+        {
+            lengthCount[maxBits] += lengthCount[bits];
+            lengthCount[bits] = 0;
+        }
+        std::uint64_t kraft = 0;
+        for(unsigned bits = 1; bits <= maxBits; ++bits)
+        {
+            kraft += std::uint64_t(lengthCount[bits]) << (maxBits - bits);
+        }
+        while(kraft > (std::uint64_t(1) << maxBits))
+        {
+            // lengthen one shorter code to make room for a code at maxBits
+            --lengthCount[maxBits];
+            for(unsigned bits = maxBits - 1; bits > 0; --bits)
+            {
+                if(lengthCount[bits])
+                {
+                    --lengthCount[bits];
+                    lengthCount[bits + 1] += 2;
+                    break;
+                }
+            }
+            --kraft;
+        }
+
+        std::size_t leaf = 0;
+        for(unsigned bits = maxBits; bits > 0; --bits)
+        {
+            for(std::uint32_t k = 0; k < lengthCount[bits]; ++k)
+            {
+                lengths[leaves[leaf++].second] = static_cast<std::uint8_t>(bits);
+            }
+        }
+    }
+
+    struct Symbol
+    {
+        std::uint16_t distance;   // 0 for a literal
+        std::uint16_t value;      // literal byte or match length
+    };
+
+    int maxChain;
+    std::size_t niceLength;
+    std::size_t maxInsert;   // longer matches do not index the positions they cover
+    Sink sink;
+
+    std::vector<std::uint8_t> window;   // 2 * windowSize bytes plus padding for over-reads
+    std::size_t windowEnd = 0;          // bytes of input in the window
+    std::size_t position = 0;           // next byte to encode
+    std::size_t blockStart = 0;         // first byte of the pending block
+    std::vector<std::uint16_t> head;    // hash -> most recent position, 0 for none
+    std::vector<std::uint16_t> prev;    // position & windowMask -> previous position with the same hash
+
+    std::vector<Symbol> symbols;        // maxBlockSymbols slots, the first symbolCount in use
+    std::size_t symbolCount = 0;
+    std::uint32_t literalFreq[literalCount];
+    std::uint32_t distanceFreq[distanceCount];
+
+    std::vector<std::uint8_t> output;
+    std::size_t outputUsed = 0;
+    std::uint64_t bitBuffer = 0;
+    unsigned bitCount = 0;
+    std::uint64_t written = 0;
+    std::uint64_t consumed = 0;
+
+    void putBits(std::uint32_t value, unsigned n)
+    {
+        bitBuffer |= std::uint64_t(value) << bitCount;
+        bitCount += n;
+        if(bitCount >= 32)
+        {
+            std::uint8_t* p = output.data() + outputUsed;
+            p[0] = static_cast<std::uint8_t>(bitBuffer);
+            p[1] = static_cast<std::uint8_t>(bitBuffer >> 8);
+            p[2] = static_cast<std::uint8_t>(bitBuffer >> 16);
+            p[3] = static_cast<std::uint8_t>(bitBuffer >> 24);
+            outputUsed += 4;
+            bitBuffer >>= 32;
+            bitCount -= 32;
+            if(outputUsed >= outputChunk)
+            {
+                drainOutput();
+            }
+        }
+    }
+
+    void alignToByte()
+    {
+        while(bitCount > 0)
+        {
+            output[outputUsed++] = static_cast<std::uint8_t>(bitBuffer);
+            bitBuffer >>= 8;
+            bitCount = bitCount > 8 ? bitCount - 8 : 0;
+        }
+        bitBuffer = 0;
+    }
+
+    void drainOutput()
+    {
+        sink(output.data(), outputUsed);
+        written += outputUsed;
+        outputUsed = 0;
+    }
+
+    std::uint32_t hashAt(std::size_t pos) const
+    {
+        std::uint32_t v;
+        std::memcpy(&v, window.data() + pos, 4);
+        return ((v & 0xFFFFFF) * 2654435761u) >> (32 - hashBits);
+    }
+
+    // Indexes `pos` and returns the previous position with the same hash.
+    std::size_t insert(std::size_t pos)
+    {
+        std::uint32_t h = hashAt(pos);
+        std::size_t candidate = head[h];
+        prev[pos & windowMask] = head[h];
+        head[h] = static_cast<std::uint16_t>(pos);
+        return candidate;
+    }
+
+    std::size_t matchLength(std::size_t a, std::size_t b, std::size_t limit) const
+    {
+        const std::uint8_t* p = window.data() + a;
+        const std::uint8_t* q = window.data() + b;
+        std::size_t len = 0;
+        while(len < limit)
+        {
+            std::uint64_t x, y;
+            std::memcpy(&x, p + len, 8);
+            std::memcpy(&y, q + len, 8);
+            if(x != y)
+            {
+                while(p[len] == q[len])
+                {
+                    ++len;
+                }
+                break;
+            }
+            len += 8;
+        }
+        return std::min(len, limit);
+    }
+
+    // Longest earlier match for `position`, following at most maxChain links.
+    std::size_t longestMatch(std::size_t candidate, std::size_t& distance) const
+    {
+        std::size_t limit = std::min(maxMatch, windowEnd - position);
+        std::size_t oldest = position > windowSize ? position - windowSize : 0;
+        std::size_t best = minMatch - 1;
+        const std::uint8_t* here = window.data() + position;
+        for(int chain = maxChain; candidate > oldest && chain > 0; --chain)
+        {
+            const std::uint8_t* there = window.data() + candidate;
+            if(there[best] == here[best] && there[0] == here[0] && there[1] == here[1])
+            {
+                std::size_t len = matchLength(candidate, position, limit);
+                if(len > best)
+                {
+                    best = len;
+                    distance = position - candidate;
+                    if(len >= niceLength || len == limit)
+                    {
+                        break;
+                    }
+                }
+            }
+            candidate = prev[candidate & windowMask];
+        }
+        return best;
+    }
+
+    void addLiteral(std::uint8_t byte)
+    {
+        symbols[symbolCount++] = {0, byte};
+        ++literalFreq[byte];
+    }
+
+    void addMatch(std::size_t length, std::size_t distance)
+    {
+        symbols[symbolCount++] = {static_cast<std::uint16_t>(distance), static_cast<std::uint16_t>(length)};
+        ++literalFreq[257 + tables().lengthSymbol[length]];
+        ++distanceFreq[tables().distanceCode(distance)];
+    }
+
+    // Encodes while enough lookahead is buffered; with `flush` runs to the end.
+    void compressAvailable(bool flush)
+    {
+        while(true)
+        {
+            std::size_t lookahead = windowEnd - position;
+            if(lookahead == 0 || (!flush && lookahead < minLookahead))
+            {
+                return;
+            }
+            std::size_t length = 0, distance = 0;
+            if(lookahead >= minMatch)
+            {
+                std::size_t candidate = insert(position);
+                if(candidate)
+                {
+                    length = longestMatch(candidate, distance);
+                }
+            }
+            if(length >= minMatch && !(length == minMatch && distance > tooFar))
+            {
+                addMatch(length, distance);
+                if(length <= maxInsert)
+                {
+                    for(std::size_t i = 1; i < length && position + i + minMatch <= windowEnd; ++i)
+                    {
+                        insert(position + i);
+                    }
+                }
+                position += length;
+            }
+            else
+            {
+                addLiteral(window[position]);
+                ++position;
+            }
+            if(symbolCount == maxBlockSymbols)
+            {
+                flushBlock(false);
+            }
+        }
+    }
+
+    void slideWindow()
+    {
+        flushBlock(false);
+        std::memmove(window.data(), window.data() + windowSize, windowEnd - windowSize);
+        windowEnd -= windowSize;
+        position -= windowSize;
+        blockStart -= windowSize;
+        for(std::uint16_t& h : head)
+        {
+            h = static_cast<std::uint16_t>(h >= windowSize ? h - windowSize : 0);
+        }
+        for(std::uint16_t& p : prev)
+        {
+            p = static_cast<std::uint16_t>(p >= windowSize ? p - windowSize : 0);
+        }
+    }
+
+    // Run length coding of the literal and distance code lengths with the
+    // repeat symbols 16 (previous, 3-6), 17 (zeros, 3-10) and 18 (zeros, 11-138).
+    static void runLengths(const std::uint8_t* lengths, std::size_t n, std::vector<std::uint8_t>& codes,
+                           std::vector<std::uint8_t>& extras)
+    {
+        for(std::size_t i = 0; i < n;)
+        {
+            std::uint8_t len = lengths[i];
+            std::size_t run = 1;
+            while(i + run < n && lengths[i + run] == len)
+            {
+                ++run;
+            }
+            i += run;
+            if(len == 0)
+            {
+                while(run >= 11)
+                {
+                    std::size_t r = std::min<std::size_t>(run, 138);
+                    codes.push_back(18);
+                    extras.push_back(static_cast<std::uint8_t>(r - 11));
+                    run -= r;
+                }
+                if(run >= 3)
+                {
+                    codes.push_back(17);
+                    extras.push_back(static_cast<std::uint8_t>(run - 3));
+                    run = 0;
+                }
+            }
+            else
+            {
+                codes.push_back(len);
+                extras.push_back(0);
+                --run;
+                while(run >= 3)
+                {
+                    std::size_t r = std::min<std::size_t>(run, 6);
+                    codes.push_back(16);
+                    extras.push_back(static_cast<std::uint8_t>(r - 3));
+                    run -= r;
+                }
+            }
+            for(; run > 0; --run)
+            {
+                codes.push_back(len);
+                extras.push_back(0);
+            }
+        }
+    }
+
+    void writeSymbols(const std::uint16_t* literalCode, const std::uint8_t* literalLength,
+                      const std::uint16_t* distanceCode, const std::uint8_t* distanceLength)
+    {
+        const Tables& t = tables();
+        for(std::size_t i = 0; i < symbolCount; ++i)
+        {
+            const Symbol& s = symbols[i];
+            if(s.distance == 0)
+            {
+                putBits(literalCode[s.value], literalLength[s.value]);
+                continue;
+            }
+            unsigned lc = t.lengthSymbol[s.value];
+            putBits(literalCode[257 + lc] | std::uint32_t(s.value - Tables::lengthBase[lc]) << literalLength[257 + lc],
+                    literalLength[257 + lc] + Tables::lengthExtra[lc]);
+            unsigned dc = t.distanceCode(s.distance);
+            putBits(distanceCode[dc] | std::uint32_t(s.distance - Tables::distanceBase[dc]) << distanceLength[dc],
+                    distanceLength[dc] + Tables::distanceExtra[dc]);
+        }
+        putBits(literalCode[256], literalLength[256]);
+    }
+
+    // Bits the pending symbols take with the given code lengths.
+    std::uint64_t symbolBits(const std::uint8_t* literalLength, const std::uint8_t* distanceLength) const
+    {
+        std::uint64_t bits = 0;
+        for(unsigned i = 0; i < literalCount; ++i)
+        {
+            bits += std::uint64_t(literalFreq[i]) * (literalLength[i] + (i >= 257 ? Tables::lengthExtra[i - 257] : 0));
+        }
+        for(unsigned i = 0; i < distanceCount; ++i)
+        {
+            bits += std::uint64_t(distanceFreq[i]) * (distanceLength[i] + Tables::distanceExtra[i]);
+        }
+        return bits;
+    }
+
+    void flushBlock(bool last)
+    {
+        static const std::uint8_t codeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        const Tables& t = tables();
+        std::size_t raw = position - blockStart;
+        if(raw == 0 && !last)
+        {
+            return;
+        }
+        literalFreq[256] = 1;
+
+        std::uint8_t literalLength[literalCount], distanceLength[distanceCount];
+        buildLengths(literalFreq, literalCount, maxCodeBits, literalLength);
+        buildLengths(distanceFreq, distanceCount, maxCodeBits, distanceLength);
+        unsigned literals = literalCount, distances = distanceCount;
+        while(literals > 257 && literalLength[literals - 1] == 0)
+        {
+            --literals;
+        }
+        while(distances > 1 && distanceLength[distances - 1] == 0)
+        {
+            --distances;
+        }
+        std::uint8_t allLengths[literalCount + distanceCount];
+        std::copy(literalLength, literalLength + literals, allLengths);
+        std::copy(distanceLength, distanceLength + distances, allLengths + literals);
+        std::vector<std::uint8_t> codes, extras;
+        runLengths(allLengths, literals + distances, codes, extras);
+        std::uint32_t codeLengthFreq[19] = {};
+        for(std::uint8_t c : codes)
+        {
+            ++codeLengthFreq[c];
+        }
+        std::uint8_t codeLengthLength[19];
+        buildLengths(codeLengthFreq, 19, maxCodeLengthBits, codeLengthLength);
+        unsigned codeLengths = 19;
+        while(codeLengths > 4 && codeLengthLength[codeLengthOrder[codeLengths - 1]] == 0)
+        {
+            --codeLengths;
+        }
+
+        std::uint64_t dynamicBits = 3 + 14 + 3 * codeLengths + symbolBits(literalLength, distanceLength);
+        for(std::size_t i = 0; i < codes.size(); ++i)
+        {
+            dynamicBits += codeLengthLength[codes[i]] + (codes[i] == 16 ? 2 : codes[i] == 17 ? 3 : codes[i] == 18 ? 7 : 0);
+        }
+        std::uint64_t fixedBits = 3 + symbolBits(t.fixedLiteralLength, t.fixedDistanceLength);
+        std::uint64_t storedBits = raw * 8 + ((raw + 65534) / 65535) * 32 + 3 + 7;
+
+        if(storedBits < dynamicBits && storedBits < fixedBits && raw > 0)
+        {
+            for(std::size_t done = 0; done < raw;)
+            {
+                std::size_t piece = std::min<std::size_t>(raw - done, 65535);
+                putBits((last && done + piece == raw) ? 1 : 0, 3);
+                alignToByte();
+                std::uint8_t* p = output.data() + outputUsed;
+                p[0] = static_cast<std::uint8_t>(piece);
+                p[1] = static_cast<std::uint8_t>(piece >> 8);
+                p[2] = static_cast<std::uint8_t>(~piece);
+                p[3] = static_cast<std::uint8_t>(~piece >> 8);
+                outputUsed += 4;
+                drainOutput();
+                sink(window.data() + blockStart + done, piece);
+                written += piece;
+                done += piece;
+            }
+        }
+        else if(fixedBits <= dynamicBits)
+        {
+            putBits(last ? 1 : 0, 1);
+            putBits(1, 2);
+            writeSymbols(t.fixedLiteralCode, t.fixedLiteralLength, t.fixedDistanceCode, t.fixedDistanceLength);
+        }
+        else
+        {
+            std::uint16_t literalCode[literalCount], distanceCode[distanceCount], codeLengthCode[19];
+            canonicalCodes(literalLength, literalCount, literalCode);
+            canonicalCodes(distanceLength, distanceCount, distanceCode);
+            canonicalCodes(codeLengthLength, 19, codeLengthCode);
+            putBits(last ? 1 : 0, 1);
+            putBits(2, 2);
+            putBits(literals - 257, 5);
+            putBits(distances - 1, 5);
+            putBits(codeLengths - 4, 4);
+            for(unsigned i = 0; i < codeLengths; ++i)
+            {
+                putBits(codeLengthLength[codeLengthOrder[i]], 3);
+            }
+            for(std::size_t i = 0; i < codes.size(); ++i)
+            {
+                std::uint8_t c = codes[i];
+                putBits(codeLengthCode[c], codeLengthLength[c]);
+                if(c >= 16)
+                {
+                    putBits(extras[i], c == 16 ? 2 : c == 17 ? 3 : 7);
+                }
+            }
+            writeSymbols(literalCode, literalLength, distanceCode, distanceLength);
+        }
+
+        symbolCount = 0;
+        std::fill(literalFreq, literalFreq + literalCount, 0);
+        std::fill(distanceFreq, distanceFreq + distanceCount, 0);
+        blockStart = position;
+    }
+
+public :
+    // level 1-3 : short chains for speed, 4-6 : balanced, 7-9 : thorough
+    DeflateEncoder(int level, Sink out)
+        : maxChain(level <= 3 ? 4 : level <= 6 ? 32 : 256),
+          niceLength(level <= 3 ? 32 : level <= 6 ? 128 : maxMatch),
+          maxInsert(level <= 3 ? 6 : level <= 6 ? 32 : maxMatch),
+          sink(std::move(out)),
+          window(2 * windowSize + maxMatch + 8, 0),
+          head(std::size_t(1) << hashBits, 0),
+          prev(windowSize, 0),
+          symbols(maxBlockSymbols),
+          output(outputChunk + 65536, 0)
+    {
+        std::fill(literalFreq, literalFreq + literalCount, 0);
+        std::fill(distanceFreq, distanceFreq + distanceCount, 0);
+    }
+
+    void write(const std::uint8_t* data, std::size_t n)
+    {
+        consumed += n;
+        while(n > 0)
+        {
+            if(windowEnd == 2 * windowSize)
+            {
+                slideWindow();
+            }
+            std::size_t take = std::min(n, 2 * windowSize - windowEnd);
+            std::memcpy(window.data() + windowEnd, data, take);
+            windowEnd += take;
+            data += take;
+            n -= take;
+            compressAvailable(false);
+        }
+    }
+
+    // Encodes what is left as the final block and drains the output.
+    void finish()
+    {
+        compressAvailable(true);
+        flushBlock(true);
+        alignToByte();
+        drainOutput();
+    }
+
+    std::uint64_t bytesIn() const { return consumed; }
+    std::uint64_t bytesOut() const { return written; }
+};
 
 // STEP1 : Stratergy Interface
 class CompressionStratergy
@@ -10,28 +742,182 @@ public :
 };
 
 // STEP2 : Concrete Stratergy
-class ZipCompression : public CompressionStratergy 
+// Writes fileName.zip holding the file deflated. The input is read in fixed
+// chunks and sizes and CRC follow the data in a data descriptor, so nothing is
+// seeked back or held in memory. Entries are limited to 4 GB (no zip64).
+class ZipCompression : public CompressionStratergy
 {
+    int level;
+
+    static constexpr std::size_t chunkSize = 1 << 16;
+
+    static void put16(std::vector<std::uint8_t>& out, std::uint32_t v)
+    {
+        out.push_back(static_cast<std::uint8_t>(v));
+        out.push_back(static_cast<std::uint8_t>(v >> 8));
+    }
+
+    static void put32(std::vector<std::uint8_t>& out, std::uint32_t v)
+    {
+        put16(out, v & 0xFFFF);
+        put16(out, v >> 16);
+    }
+
+    static std::uint32_t dosDateTime()
+    {
+        std::time_t now = std::time(nullptr);
+        std::tm local = *std::localtime(&now);
+        std::uint32_t time = (local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2);
+        std::uint32_t date = ((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday;
+        return (date << 16) | time;
+    }
+
 public :
-    void compress(std::string fileName) override 
+    explicit ZipCompression(int compressionLevel = 6) : level(compressionLevel) {}
+
+    void compress(std::string fileName) override
     {
         std::cout<<"compressing "<<fileName << " using zip format"<<std::endl;
+        std::ifstream in(fileName, std::ios::binary);
+        if(!in)
+        {
+            std::cout<<"cannot open "<<fileName<<std::endl;
+            return;
+        }
+        in.seekg(0, std::ios::end);
+        std::uint64_t size = static_cast<std::uint64_t>(in.tellg());
+        in.seekg(0, std::ios::beg);
+        if(size >= 0xFFFFFFFFull)
+        {
+            std::cout<<fileName<<" is too large for a zip entry without zip64"<<std::endl;
+            return;
+        }
+        std::string zipName = fileName + ".zip";
+        std::ofstream out(zipName, std::ios::binary | std::ios::trunc);
+        if(!out)
+        {
+            std::cout<<"cannot write "<<zipName<<std::endl;
+            return;
+        }
+        // a half written archive is removed rather than left looking valid
+        auto abandon = [&out, &zipName](const std::string& reason)
+        {
+            std::cout<<reason<<std::endl;
+            out.close();
+            std::remove(zipName.c_str());
+        };
+
+        std::string entryName = fileName.substr(fileName.find_last_of("/\\") + 1);
+        std::uint32_t stamp = dosDateTime();
+        std::vector<std::uint8_t> header;
+        put32(header, 0x04034b50);
+        put16(header, 20);                 // version needed : deflate
+        put16(header, 0x0008);             // sizes and CRC in the data descriptor
+        put16(header, 8);                  // method : deflate
+        put32(header, stamp);
+        put32(header, 0);
+        put32(header, 0);
+        put32(header, 0);
+        put16(header, static_cast<std::uint32_t>(entryName.size()));
+        put16(header, 0);
+        header.insert(header.end(), entryName.begin(), entryName.end());
+        out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        std::uint32_t localHeaderSize = static_cast<std::uint32_t>(header.size());
+
+        auto start = std::chrono::steady_clock::now();
+        DeflateEncoder encoder(level, [&out](const std::uint8_t* data, std::size_t n)
+        {
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(n));
+        });
+        std::uint32_t crc = 0;
+        std::vector<std::uint8_t> chunk(chunkSize);
+        while(in)
+        {
+            in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+            std::size_t got = static_cast<std::size_t>(in.gcount());
+            crc = Crc32::update(crc, chunk.data(), got);
+            encoder.write(chunk.data(), got);
+        }
+        if(in.bad())
+        {
+            abandon("cannot read " + fileName);
+            return;
+        }
+        encoder.finish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // the file may have grown since it was measured, and incompressible
+        // data comes out slightly larger than it went in
+        if(encoder.bytesIn() > 0xFFFFFFFEull || encoder.bytesOut() > 0xFFFFFFFEull ||
+           localHeaderSize + encoder.bytesOut() + 16 >= 0xFFFFFFFFull)
+        {
+            abandon(fileName + " is too large for a zip entry without zip64");
+            return;
+        }
+        std::uint32_t compressed = static_cast<std::uint32_t>(encoder.bytesOut());
+        std::uint32_t original = static_cast<std::uint32_t>(encoder.bytesIn());
+
+        std::vector<std::uint8_t> tail;
+        put32(tail, 0x08074b50);
+        put32(tail, crc);
+        put32(tail, compressed);
+        put32(tail, original);
+        std::uint32_t directoryOffset = localHeaderSize + compressed + static_cast<std::uint32_t>(tail.size());
+        std::size_t directoryStart = tail.size();
+        put32(tail, 0x02014b50);
+        put16(tail, 20);                   // made by : MS-DOS compatible
+        put16(tail, 20);
+        put16(tail, 0x0008);
+        put16(tail, 8);
+        put32(tail, stamp);
+        put32(tail, crc);
+        put32(tail, compressed);
+        put32(tail, original);
+        put16(tail, static_cast<std::uint32_t>(entryName.size()));
+        put16(tail, 0);                    // extra field
+        put16(tail, 0);                    // comment
+        put16(tail, 0);                    // disk
+        put16(tail, 0);                    // internal attributes
+        put32(tail, 0);                    // external attributes
+        put32(tail, 0);                    // local header offset
+        tail.insert(tail.end(), entryName.begin(), entryName.end());
+        std::uint32_t directorySize = static_cast<std::uint32_t>(tail.size() - directoryStart);
+        put32(tail, 0x06054b50);
+        put16(tail, 0);
+        put16(tail, 0);
+        put16(tail, 1);
+        put16(tail, 1);
+        put32(tail, directorySize);
+        put32(tail, directoryOffset);
+        put16(tail, 0);
+        out.write(reinterpret_cast<const char*>(tail.data()), static_cast<std::streamsize>(tail.size()));
+        if(!out)
+        {
+            abandon("cannot write " + zipName);
+            return;
+        }
+
+        std::cout<<zipName<<" : "<<original<<" -> "<<compressed<<" bytes";
+        if(original > 0)
+        {
+            std::cout<<" ("<<100.0 * compressed / original<<"%)";
+        }
+        std::cout<<" in "<<seconds * 1000<<" ms, "<<(seconds > 0 ? original / seconds / 1e6 : 0.0)<<" MB/s"<<std::endl;
     }
 };
 
 class RarCompression : public CompressionStratergy
 {
 public :
-    void compress(std::string fileName) override 
+    void compress(std::string fileName) override
     {
         std::cout<<"compression "<<fileName << " using Rar fomat"<<std::endl;
     }
 };
 
-class SevenZCompression : public CompressionStratergy 
+class SevenZCompression : public CompressionStratergy
 {
 public :
-    void compress(std::string fileName) override 
+    void compress(std::string fileName) override
     {
         std::cout<<"compression "<<fileName<<" using SevenZCompression"<<std::endl;
     }
@@ -53,25 +939,28 @@ public :
         {
             stratergy->compress(fileName);
         }
-        else 
+        else
         {
             std::cout<<"compression stratergy not set"<<std::endl;
         }
     }
 };
 
-int main()
+// compress [file] [zip level 1-9]
+int main(int argc, char* argv[])
 {
     FileCompressor compressor;
+    std::string fileName = argc > 1 ? argv[1] : "file1.txt";
+    int level = argc > 2 ? std::stoi(argv[2]) : 6;
 
-    compressor.setCompressionStratergy(std::make_unique<ZipCompression>());
-    compressor.compressFile("file1.txt");
+    compressor.setCompressionStratergy(std::make_unique<ZipCompression>(level));
+    compressor.compressFile(fileName);
 
     compressor.setCompressionStratergy(std::make_unique<RarCompression>());
-    compressor.compressFile("file2.txt");
+    compressor.compressFile(argc > 1 ? fileName : "file2.txt");
 
     compressor.setCompressionStratergy(std::make_unique<SevenZCompression>());
-    compressor.compressFile("file3.txt");
-    
+    compressor.compressFile(argc > 1 ? fileName : "file3.txt");
+
     return 0;
-}
\ No newline at end of file
+}
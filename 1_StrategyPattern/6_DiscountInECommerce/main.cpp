@@ -1,42 +1,76 @@
 #include <iostream>
 #include <memory>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <algorithm>
+
+#include "../Money.h"
 
 // STEP 1 : Stratergy Interface 
 class DiscountStratergy
 {
 public :
-    virtual double applyDiscount(double price) = 0;
+    virtual Money applyDiscount(Money price) = 0;
     virtual ~DiscountStratergy() = default;
+
+    // Prices a whole cart with one call and reports the discount once, like
+    // applyDiscount does for a single item.
+    virtual void applyDiscountBatch(const Money* prices, Money* out, std::size_t n)
+    {
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            out[i] = applyDiscount(prices[i]);
+        }
+    }
 };
 
 // STEP 2 : 
 class NoDiscount : public DiscountStratergy
 {
 public :
-    double applyDiscount(double price) override 
+    Money applyDiscount(Money price) override 
     {
         std::cout<<"No Discount is applied "<<std::endl;
         return price;
     }
+
+    void applyDiscountBatch(const Money* prices, Money* out, std::size_t n) override
+    {
+        std::cout<<"No Discount is applied "<<std::endl;
+        std::copy(prices, prices + n, out);
+    }
 };
 
 class SesonalDiscount : public DiscountStratergy
 {
 public :
-    double applyDiscount(double price) override 
+    Money applyDiscount(Money price) override 
+    {
+        std::cout<<"Sesonal Discount 10% applied"<<std::endl;
+        return price.scaled(9000); // 10% off
+    }
+
+    void applyDiscountBatch(const Money* prices, Money* out, std::size_t n) override
     {
         std::cout<<"Sesonal Discount 10% applied"<<std::endl;
-        return price * 0.1; // 10% off
+        moneykernels::scale(prices, out, n, 9000);
     }
 };
 
 class BlackFridayDiscount : public DiscountStratergy
 {
 public :
-    double applyDiscount(double price) override 
+    Money applyDiscount(Money price) override 
+    {
+        std::cout<<"BlackFridayDiscount 50% applied"<<std::endl;
+        return price.scaled(5000); // 50% off
+    }
+
+    void applyDiscountBatch(const Money* prices, Money* out, std::size_t n) override
     {
         std::cout<<"BlackFridayDiscount 50% applied"<<std::endl;
-        return price * 0.5; // 50% off
+        moneykernels::scale(prices, out, n, 5000);
     }
 };
 
@@ -51,12 +85,23 @@ public :
         stratergy = std::move(s);
     }
 
-    void checkout(double amount)
+    void checkout(Money amount)
     {
-        double price = stratergy->applyDiscount(amount);
+        Money price = stratergy->applyDiscount(amount);
         std::cout<<"original price INR : "<<amount<<std::endl;
         std::cout<<"Final price after discount INR : "<<price<<std::endl;
     }
+
+    // Prices a whole cart with one strategy call and returns the total to pay.
+    Money checkoutItems(const std::vector<Money>& items)
+    {
+        discounted.resize(items.size());
+        stratergy->applyDiscountBatch(items.data(), discounted.data(), items.size());
+        return moneykernels::sum(discounted.data(), discounted.size());
+    }
+
+private :
+    std::vector<Money> discounted;
 };
 
 int main()
@@ -64,16 +109,20 @@ int main()
     ShoppingCart cart;
 
     cart.setDiscountStratergy(std::make_unique<SesonalDiscount>());
-    cart.checkout(40000.00);
+    cart.checkout(Money::fromRupees(40000.00));
     std::cout<<std::endl;
 
     cart.setDiscountStratergy(std::make_unique<NoDiscount>());
-    cart.checkout(40000.00);
+    cart.checkout(Money::fromRupees(40000.00));
     std::cout<<std::endl;
 
     cart.setDiscountStratergy(std::make_unique<BlackFridayDiscount>());
-    cart.checkout(40000.00);
+    cart.checkout(Money::fromRupees(40000.00));
     std::cout<<std::endl;
+
+    std::vector<Money> items = {Money::fromRupees(499.99), Money::fromRupees(1299.50), Money::fromRupees(89.75)};
+    Money total = cart.checkoutItems(items);
+    std::cout<<"cart of "<<items.size()<<" items, BlackFriday total INR : "<<total<<std::endl;
     
     return 0;
 }
\ No newline at end of file
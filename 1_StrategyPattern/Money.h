@@ -0,0 +1,97 @@
+// Money.h : exact rupee amounts and the batch kernels over them, shared by
+// the payment and discount examples.
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <ostream>
+
+// Rupee amount held as a whole number of paise, so totals are exact and
+// integer kernels can add millions of amounts without rounding drift.
+class Money
+{
+    std::int64_t paise = 0;
+    constexpr explicit Money(std::int64_t p) : paise(p) {}
+public :
+    constexpr Money() = default;
+
+    static constexpr Money fromPaise(std::int64_t p) { return Money(p); }
+    // The one place a double is rounded : amounts typed in by a user.
+    static Money fromRupees(double rupees) { return Money(std::llround(rupees * 100.0)); }
+
+    constexpr std::int64_t toPaise() const { return paise; }
+
+    // amount * basisPoints / 10000, rounded half away from zero
+    constexpr Money scaled(std::int64_t basisPoints) const
+    {
+        std::int64_t p = paise * basisPoints;
+        return Money((p + (p < 0 ? -5000 : 5000)) / 10000);
+    }
+
+    constexpr Money& operator+=(Money other) { paise += other.paise; return *this; }
+    constexpr Money& operator-=(Money other) { paise -= other.paise; return *this; }
+    friend constexpr Money operator+(Money a, Money b) { return Money(a.paise + b.paise); }
+    friend constexpr Money operator-(Money a, Money b) { return Money(a.paise - b.paise); }
+    friend constexpr bool operator==(Money a, Money b) { return a.paise == b.paise; }
+    friend constexpr bool operator!=(Money a, Money b) { return a.paise != b.paise; }
+    friend constexpr bool operator<(Money a, Money b) { return a.paise < b.paise; }
+    friend constexpr bool operator>(Money a, Money b) { return a.paise > b.paise; }
+
+    std::string str() const
+    {
+        std::int64_t whole = paise / 100;
+        std::int64_t frac = paise % 100;
+        std::string s = (paise < 0 && whole == 0) ? "-0" : std::to_string(whole);
+        frac = frac < 0 ? -frac : frac;
+        return s + (frac < 10 ? ".0" : ".") + std::to_string(frac);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, Money m)
+    {
+        return os<<m.str();
+    }
+};
+static_assert(sizeof(Money) == sizeof(std::int64_t), "Money arrays are plain int64 arrays");
+
+// Batch kernels over Money arrays. Plain integer loops with no branches, so
+// the sum vectorizes and every result is identical on every target.
+namespace moneykernels
+{
+    inline Money sum(const Money* amounts, std::size_t n)
+    {
+        std::int64_t acc[4] = {};
+        std::size_t i = 0;
+        for(; i + 4 <= n; i += 4)
+        {
+            acc[0] += amounts[i].toPaise();
+            acc[1] += amounts[i + 1].toPaise();
+            acc[2] += amounts[i + 2].toPaise();
+            acc[3] += amounts[i + 3].toPaise();
+        }
+        for(; i < n; ++i)
+        {
+            acc[0] += amounts[i].toPaise();
+        }
+        return Money::fromPaise(acc[0] + acc[1] + acc[2] + acc[3]);
+    }
+
+    // out[i] = in[i] * basisPoints / 10000, e.g. 9000 for 10% off
+    inline void scale(const Money* in, Money* out, std::size_t n, std::int64_t basisPoints)
+    {
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            out[i] = in[i].scaled(basisPoints);
+        }
+    }
+
+    // out[i] = in[i] plus tax at basisPoints, e.g. 1800 for 18% GST
+    inline void addTax(const Money* in, Money* out, std::size_t n, std::int64_t basisPoints)
+    {
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            out[i] = in[i] + in[i].scaled(basisPoints);
+        }
+    }
+}